@@ -0,0 +1,44 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include "bench-common.h"
+
+// glibc still exports its allocator under these names
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+
+static std::atomic<uint64_t> allocations;
+
+extern "C" void *malloc(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+
+uint64_t benchAllocations(void)
+{
+    return allocations.load(std::memory_order_relaxed);
+}
+
+double benchPercentile(std::vector<double> &values, double p)
+{
+    if (values.empty())
+        return 0;
+    size_t n = std::min(values.size() - 1, (size_t)(p * values.size()));
+    std::nth_element(values.begin(), values.begin() + n, values.end());
+    return values[n];
+}
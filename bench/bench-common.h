@@ -0,0 +1,15 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#pragma once
+#include <cstdint>
+#include <vector>
+
+/*
+ * Helpers shared by the benchmarks. Linking bench-common also interposes malloc(), calloc() and
+ * realloc() to count every allocation of the process, including those made inside Qt.
+ */
+
+/* Number of allocations so far */
+uint64_t benchAllocations(void);
+
+/* The value at fraction @p of @values (reordering them), or 0 if there are none */
+double benchPercentile(std::vector<double> &values, double p);
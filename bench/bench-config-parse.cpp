@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Cost of parsing a configuration file. A tint2 style theme with many background sections is
+ * generated, or read from the given file, and parsed repeatedly from memory on top of the
+ * built-in configuration, so that neither the disk nor Qt's style setup is measured.
+ *
+ * Usage: bench-config-parse [-s sections] [-i iterations] [config]
+ *
+ * Defaults are 2000 background sections and 200 iterations.
+ *
+ * Output is one tab separated metric per line.
+ */
+#include <algorithm>
+#include <chrono>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <print>
+#include <string>
+#include <vector>
+#include <QGuiApplication>
+#include "bench-common.h"
+#include "conf.h"
+
+static constexpr int DEFAULT_SECTIONS = 2000;
+static constexpr int DEFAULT_ITERATIONS = 200;
+
+/* Backgrounds first, as in tint2 themes, then the settings referring to them */
+static std::string synthesize(int sections)
+{
+    std::string text = "# Generated by bench-config-parse\n\n";
+    for (int i = 1; i <= sections; i++) {
+        text += std::format("# Background {}\nrounded = {}\n", i, i % 8);
+        unsigned rgb = (i * 2654435u) & 0xffffff;
+        text += std::format("background_color = #{:06x} {}\n", rgb, i % 101);
+        text += std::format("border_color = #{:06x} {}\n\n", rgb ^ 0xffffff, 100 - i % 101);
+    }
+    int id = sections;
+    text += "panel_items = TC\npanel_size = 100% 30\npanel_outputs = all\n";
+    text += std::format("panel_background_id = {}\n", id);
+    text += std::format("taskbar_background_id = {}\ntaskbar_padding = 2 2 4\n", id);
+    text += "taskbar_grouping = 0\ntask_maximum_size = 200 32\ntask_minimum_size = 40\n";
+    text += "task_font = Sans Regular 10\ntask_font_color = #ffffff 100\n";
+    text += std::format("task_background_id = {}\ntask_active_background_id = {}\n", id, id);
+    text += std::format("clock_background_id = {}\n", id);
+    text += "time1_format = %H:%M\ntime2_format = %a %d %b\n";
+    text += "time1_font = Sans Bold 10\ntime2_font = Sans Regular 8\n";
+    text += "clock_font_color = #ffffff 100\nicon_cache_size = 2048\n";
+    return text;
+}
+
+int main(int argc, char **argv)
+{
+    QGuiApplication app(argc, argv);
+
+    std::string config;
+    int sections = DEFAULT_SECTIONS;
+    int iterations = DEFAULT_ITERATIONS;
+    QStringList args = app.arguments();
+    for (int i = 1; i < args.size(); i++) {
+        if (args[i] == "-s" && i + 1 < args.size())
+            sections = std::max(0, args[++i].toInt());
+        else if (args[i] == "-i" && i + 1 < args.size())
+            iterations = std::max(1, args[++i].toInt());
+        else
+            config = args[i].toStdString();
+    }
+
+    std::string text;
+    if (config.empty()) {
+        text = synthesize(sections);
+        config = "<generated>";
+    } else {
+        std::ifstream file(config, std::ios::binary);
+        if (!file.is_open()) {
+            std::println(stderr, "cannot read '{}'", config);
+            return 1;
+        }
+        text.assign(std::istreambuf_iterator<char>(file), {});
+    }
+    confInit("/dev/null");
+
+    std::vector<double> us;
+    uint64_t allocs = 0;
+    for (int i = 0; i < iterations; i++) {
+        // Drop the backgrounds of the previous pass, keeping the built-in transparent one
+        conf.backgrounds.resize(1);
+        uint64_t start = benchAllocations();
+        auto t0 = std::chrono::steady_clock::now();
+        confParse(text, config);
+        std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - t0;
+        allocs += benchAllocations() - start;
+        us.push_back(elapsed.count());
+    }
+
+    size_t lines = std::ranges::count(text, '\n');
+    double median = benchPercentile(us, 0.5);
+    std::println("lines\t{}", lines);
+    std::println("bytes\t{}", text.size());
+    std::println("backgrounds\t{}", conf.backgrounds.size() - 1);
+    std::println("parse_us_median\t{:.1f}", median);
+    std::println("parse_us_p99\t{:.1f}", benchPercentile(us, 0.99));
+    std::println("ns_per_line\t{:.1f}", lines ? median * 1000 / lines : 0.0);
+    std::println("mb_per_s\t{:.1f}", median > 0 ? text.size() / median : 0.0);
+    std::println("allocs_per_parse\t{:.1f}", (double)allocs / iterations);
+    return 0;
+}
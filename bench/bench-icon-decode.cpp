@@ -0,0 +1,131 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Decode time and peak memory per icon for the old QIcon based path and loadIconImage(), over a
+ * synthetic icon set of large PNGs, SVGs and XPMs. Each (icon, loader) pair runs in its own
+ * process so that ru_maxrss reflects that pair alone.
+ *
+ * Output is one tab separated line per pair: loader, icon, median decode time in microseconds and
+ * peak RSS growth in KiB.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <print>
+#include <string>
+#include <vector>
+#include <QGuiApplication>
+#include <QIcon>
+#include <QImage>
+#include <QPainter>
+#include <QTemporaryDir>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "icon-loader.h"
+
+static constexpr int ICON_SIZE = 22;
+static constexpr int ITERATIONS = 20;
+
+static void write_png(const std::string &path, int size)
+{
+    QImage image(size, size, QImage::Format_ARGB32);
+    image.fill(Qt::transparent);
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setBrush(QColor("#3070c0"));
+    int margin = size / 16;
+    painter.drawEllipse(QRect(0, 0, size, size).adjusted(margin, margin, -margin, -margin));
+    painter.end();
+    image.save(QString::fromStdString(path), "PNG");
+}
+
+static void write_svg(const std::string &path, int size)
+{
+    std::ofstream file(path);
+    std::print(file,
+               "<svg xmlns='http://www.w3.org/2000/svg' width='{0}' height='{0}'>"
+               "<rect x='{1}' y='{1}' width='{2}' height='{2}' rx='{1}' fill='#c07030'/>"
+               "<circle cx='{3}' cy='{3}' r='{1}' fill='#ffffff'/></svg>",
+               size, size / 8, size * 3 / 4, size / 2);
+}
+
+static void write_xpm(const std::string &path, int size)
+{
+    QImage image(size, size, QImage::Format_RGB32);
+    image.fill(QColor("#30c070"));
+    image.save(QString::fromStdString(path), "XPM");
+}
+
+static long current_rss_kb(void)
+{
+    long pages = 0;
+    std::ifstream statm("/proc/self/statm");
+    statm >> pages >> pages;
+    return pages * sysconf(_SC_PAGESIZE) / 1024;
+}
+
+static QImage decode(const std::string &loader, const std::string &path)
+{
+    if (loader == "qicon")
+        return QIcon(QString::fromStdString(path)).pixmap(QSize(ICON_SIZE, ICON_SIZE)).toImage();
+    return loadIconImage(path, ICON_SIZE);
+}
+
+static void run(int argc, char **argv, const std::string &loader, const std::string &path)
+{
+    QGuiApplication app(argc, argv);
+    long baseline = current_rss_kb();
+
+    std::vector<double> times;
+    for (int i = 0; i < ITERATIONS; i++) {
+        auto start = std::chrono::steady_clock::now();
+        QImage image = decode(loader, path);
+        auto end = std::chrono::steady_clock::now();
+        if (image.isNull()) {
+            std::println(stderr, "{}: cannot decode {}", loader, path);
+            exit(EXIT_FAILURE);
+        }
+        times.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+    }
+    std::ranges::sort(times);
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    std::string name = path.substr(path.rfind('/') + 1);
+    std::println("{}\t{}\t{:.1f}\t{}", loader, name, times[times.size() / 2],
+                 std::max(usage.ru_maxrss - baseline, 0L));
+    fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+    QTemporaryDir dir;
+    std::string base = dir.path().toStdString();
+    std::vector<std::string> icons;
+    for (int size : { 256, 512, 1024 }) {
+        icons.push_back(std::format("{}/icon-{}.png", base, size));
+        write_png(icons.back(), size);
+        icons.push_back(std::format("{}/icon-{}.svg", base, size));
+        write_svg(icons.back(), size);
+    }
+    icons.push_back(std::format("{}/icon-128.xpm", base));
+    write_xpm(icons.back(), 128);
+
+    std::println("loader\ticon\tmedian_us\tpeak_rss_kb");
+    int failures = 0;
+    for (auto &path : icons) {
+        for (const char *loader : { "qicon", "loader" }) {
+            pid_t pid = fork();
+            if (pid == 0) {
+                run(argc, argv, loader, path);
+                _exit(EXIT_SUCCESS);
+            }
+            int status;
+            waitpid(pid, &status, 0);
+            if (!WIFEXITED(status) || WEXITSTATUS(status))
+                failures++;
+        }
+    }
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
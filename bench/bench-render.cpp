@@ -0,0 +1,212 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Paint cost of the panel without a compositor. The panel scene is built for the (offscreen)
+ * primary screen with a number of synthetic tasks, whose icons are resolved and decoded from a
+ * generated icon theme, and the clock. Both renderers are timed for full repaints and for
+ * partial repaints of the clock as it ticks: the QGraphicsView renderer by repainting the view,
+ * the raster renderer by painting the scene items into an image as RasterPanel does.
+ *
+ * Usage: bench-render [-c config] [-n tasks] [-f frames]
+ *
+ * Defaults are the built-in configuration, 40 tasks and 500 frames per measurement.
+ *
+ * Output is one tab separated line per renderer and kind of repaint: renderer, kind, median and
+ * p99 paint time in microseconds and allocations per frame, followed by the peak RSS in KiB.
+ */
+#include <algorithm>
+#include <chrono>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <print>
+#include <string>
+#include <thread>
+#include <vector>
+#include <QApplication>
+#include <QDir>
+#include <QGraphicsView>
+#include <QIcon>
+#include <QImage>
+#include <QPainter>
+#include <QScreen>
+#include <QTemporaryDir>
+#include <sys/resource.h>
+#include "bench-common.h"
+#include "conf.h"
+#include "icon-cache.h"
+#include "panel.h"
+#include "plugin-clock.h"
+#include "plugin-taskbar.h"
+#include "resources.h"
+#include "toplevel-record.h"
+
+static constexpr int DEFAULT_TASKS = 40;
+static constexpr int DEFAULT_FRAMES = 500;
+static constexpr int WARMUP_FRAMES = 10;
+static constexpr int ICON_APPS = 24;
+
+/* Desktop files and a hicolor theme with one PNG icon for each synthetic application */
+static void write_icon_theme(const QString &root)
+{
+    QDir(root).mkpath("applications");
+    QDir(root).mkpath("icons/hicolor/48x48/apps");
+    std::ofstream index((root + "/icons/hicolor/index.theme").toStdString());
+    std::print(index, "[Icon Theme]\nName=Hicolor\nDirectories=48x48/apps\n\n"
+                      "[48x48/apps]\nSize=48\nType=Scalable\nMinSize=8\nMaxSize=256\n");
+
+    for (int i = 0; i < ICON_APPS; i++) {
+        QImage image(48, 48, QImage::Format_ARGB32);
+        image.fill(Qt::transparent);
+        QPainter painter(&image);
+        painter.setRenderHint(QPainter::Antialiasing);
+        painter.setBrush(QColor::fromHsv(i * 360 / ICON_APPS, 160, 200));
+        painter.drawEllipse(QRect(2, 2, 44, 44));
+        painter.end();
+        image.save(QString("%1/icons/hicolor/48x48/apps/bench-app%2.png").arg(root).arg(i));
+
+        std::ofstream desktop(
+                std::format("{}/applications/org.example.app{}.desktop", root.toStdString(), i));
+        std::print(desktop, "[Desktop Entry]\nType=Application\nName=App {0}\nExec=true\n"
+                            "Icon=bench-app{0}\n", i);
+    }
+}
+
+static std::vector<struct toplevel_update> synthesize(int count)
+{
+    std::vector<struct toplevel_update> updates;
+    for (int i = 0; i < count; i++) {
+        struct toplevel_update update = {};
+        update.id = i + 1;
+        update.added = true;
+        update.pending.app_id = std::format("org.example.app{}", i % ICON_APPS);
+        update.pending.title = std::format("Document {} - App {}", i + 1, i % ICON_APPS);
+        update.pending.state = i == 0 ? TASK_ACTIVE : 0;
+        updates.push_back(std::move(update));
+    }
+    return updates;
+}
+
+/* Icons are decoded on worker threads and arrive through the event loop; wait for the last */
+static void wait_for_icons(void)
+{
+    size_t bytes = 0;
+    int unchanged = 0;
+    for (int i = 0; i < 500 && unchanged < 10; i++) {
+        QCoreApplication::processEvents();
+        size_t now = iconCacheStats().bytes;
+        unchanged = now == bytes ? unchanged + 1 : 0;
+        bytes = now;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+static void measure(const char *renderer, const char *kind, int frames,
+                    const std::function<void(void)> &paint)
+{
+    for (int i = 0; i < WARMUP_FRAMES; i++)
+        paint();
+
+    std::vector<double> us;
+    uint64_t start = benchAllocations();
+    for (int i = 0; i < frames; i++) {
+        auto t0 = std::chrono::steady_clock::now();
+        paint();
+        std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - t0;
+        us.push_back(elapsed.count());
+    }
+    double allocs = (double)(benchAllocations() - start) / frames;
+    std::println("{}\t{}\t{:.1f}\t{:.1f}\t{:.1f}", renderer, kind, benchPercentile(us, 0.5),
+                 benchPercentile(us, 0.99), allocs);
+}
+
+int main(int argc, char **argv)
+{
+    // Only the generated theme and desktop files are visible to the resource loading
+    QTemporaryDir data;
+    write_icon_theme(data.path());
+    setenv("XDG_DATA_HOME", data.path().toUtf8().constData(), 1);
+    setenv("XDG_DATA_DIRS", data.path().toUtf8().constData(), 1);
+    setenv("XDG_CACHE_HOME", (data.path() + "/cache").toUtf8().constData(), 1);
+
+    QApplication app(argc, argv);
+    QIcon::setThemeName("hicolor");
+
+    QString config = "/dev/null";
+    int tasks = DEFAULT_TASKS;
+    int frames = DEFAULT_FRAMES;
+    QStringList args = app.arguments();
+    for (int i = 1; i + 1 < args.size(); i += 2) {
+        if (args[i] == "-c")
+            config = args[i + 1];
+        else if (args[i] == "-n")
+            tasks = std::max(0, args[i + 1].toInt());
+        else if (args[i] == "-f")
+            frames = std::max(1, args[i + 1].toInt());
+    }
+    confInit(config);
+
+    struct sfdo sfdo;
+    desktopEntryInit(&sfdo);
+    desktopEntryLoadAsync(&sfdo);
+    iconCacheSetLimit((size_t)conf.icon_cache_size * 1024);
+
+    ToplevelReplay replay;
+    auto scene = new PanelScene(QGuiApplication::primaryScreen(), &sfdo, &replay);
+    replay.deliver(synthesize(tasks));
+    wait_for_icons();
+
+    ClockItem *clock = nullptr;
+    for (QGraphicsItem *item : scene->items()) {
+        if (item->type() == ClockItem::Type)
+            clock = static_cast<ClockItem *>(item);
+    }
+    QRect full = scene->sceneRect().toAlignedRect();
+    if (!clock)
+        std::println(stderr, "no clock in panel_items; partial repaints are skipped");
+    QRect partial = clock ? clock->sceneBoundingRect().toAlignedRect().adjusted(-1, -1, 1, 1)
+                          : QRect();
+
+    // Set up like View, without the frame scheduler
+    auto view = new QGraphicsView(scene);
+    view->setRenderHint(QPainter::Antialiasing);
+    view->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    view->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    view->setViewportUpdateMode(QGraphicsView::NoViewportUpdate);
+    view->setFrameStyle(QFrame::NoFrame);
+    view->setFixedSize(full.size());
+    view->setSceneRect(full);
+    view->show();
+    QCoreApplication::processEvents();
+
+    std::println("renderer\tkind\tmedian_us\tp99_us\tallocs_per_frame");
+    measure("scene", "full", frames, [&]() { view->viewport()->repaint(full); });
+    if (clock) {
+        measure("scene", "partial", frames, [&]() {
+            clock->setTime();
+            view->viewport()->repaint(partial);
+        });
+    }
+
+    QImage image(full.size(), QImage::Format_ARGB32_Premultiplied);
+    auto paint_image = [&](const QRect &rect) {
+        QPainter painter(&image);
+        panelPaintItems(scene, &painter, rect);
+    };
+    measure("raster", "full", frames, [&]() { paint_image(full); });
+    if (clock) {
+        measure("raster", "partial", frames, [&]() {
+            clock->setTime();
+            paint_image(partial);
+        });
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    std::println("peak_rss_kb\t{}", usage.ru_maxrss);
+
+    delete view;
+    delete scene;
+    iconCacheFinish();
+    desktopEntryFinish(&sfdo);
+    return 0;
+}
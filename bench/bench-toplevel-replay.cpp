@@ -0,0 +1,192 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Replay a foreign-toplevel event stream into a headless taskbar and report how long each event
+ * took to process, how many repaints the stream triggered and the peak RSS.
+ *
+ * Usage: bench-toplevel-replay [-c config] [--realtime] [recording]
+ *
+ * Recordings are made with 'tint --record-toplevels <file>'. Without one, a synthetic stream of
+ * a few hundred windows being switched, retitled, minimized, closed and opened is used. Batches
+ * are fed as fast as possible unless --realtime is given, in which case the recorded timing is
+ * kept.
+ *
+ * Output is one tab separated metric per line.
+ */
+#include <chrono>
+#include <print>
+#include <string>
+#include <thread>
+#include <vector>
+#include <QApplication>
+#include <QGraphicsScene>
+#include <QGraphicsView>
+#include <sys/resource.h>
+#include "bench-common.h"
+#include "conf.h"
+#include "icon-cache.h"
+#include "plugin-taskbar.h"
+#include "resources.h"
+#include "toplevel-record.h"
+
+static constexpr int PANEL_WIDTH = 1920;
+static constexpr int SYNTHETIC_WINDOWS = 300;
+static constexpr int SYNTHETIC_APPS = 40;
+static constexpr int SYNTHETIC_BATCHES = 5000;
+
+class CountingView : public QGraphicsView
+{
+public:
+    using QGraphicsView::QGraphicsView;
+    uint64_t repaints = 0;
+
+protected:
+    void paintEvent(QPaintEvent *event) override
+    {
+        repaints++;
+        QGraphicsView::paintEvent(event);
+    }
+};
+
+/* Deterministic, so that runs can be compared */
+static std::vector<struct toplevel_batch> synthesize(void)
+{
+    std::vector<struct toplevel_batch> batches;
+    uint32_t seed = 1;
+    auto random = [&seed](uint32_t n) {
+        seed = seed * 1103515245 + 12345;
+        return (seed >> 16) % n;
+    };
+    auto window = [&](uint32_t id) {
+        struct toplevel_update update = {};
+        update.id = id;
+        update.added = true;
+        update.pending.app_id = "org.example.app" + std::to_string(random(SYNTHETIC_APPS));
+        update.pending.title = "Window " + std::to_string(id);
+        update.pending.state = 0;
+        return update;
+    };
+
+    std::vector<uint32_t> open;
+    uint32_t next_id = 1;
+    struct toplevel_batch batch = { std::chrono::microseconds(0), {} };
+    for (int i = 0; i < SYNTHETIC_WINDOWS; i++) {
+        open.push_back(next_id);
+        batch.updates.push_back(window(next_id++));
+    }
+    batches.push_back(std::move(batch));
+
+    uint32_t active = 0;
+    for (int i = 1; i <= SYNTHETIC_BATCHES; i++) {
+        batch = { std::chrono::microseconds(i * 5000), {} };
+        uint32_t id = open[random(open.size())];
+        uint32_t action = random(10);
+        struct toplevel_update update = {};
+        update.id = id;
+        if (action < 6) {
+            if (active)
+                batch.updates.push_back({ .id = active, .added = false, .closed = false,
+                                          .pending = { .state = 0 } });
+            update.pending.state = TASK_ACTIVE;
+            active = id;
+        } else if (action < 8) {
+            update.pending.title = "Window " + std::to_string(id) + " - " + std::to_string(i);
+        } else if (action < 9) {
+            update.pending.state = id == active ? 0 : TASK_MINIMIZED;
+        } else {
+            update.closed = true;
+            std::erase(open, id);
+            if (id == active)
+                active = 0;
+            open.push_back(next_id);
+            batch.updates.push_back(std::move(update));
+            update = window(next_id++);
+        }
+        batch.updates.push_back(std::move(update));
+        batches.push_back(std::move(batch));
+    }
+    return batches;
+}
+
+/* Let queued scene updates turn into paint events and be painted */
+static void settle(void)
+{
+    QCoreApplication::processEvents();
+    QCoreApplication::processEvents();
+}
+
+int main(int argc, char **argv)
+{
+    QApplication app(argc, argv);
+
+    QString config = "/dev/null";
+    std::string recording;
+    bool realtime = false;
+    QStringList args = app.arguments();
+    for (int i = 1; i < args.size(); i++) {
+        if (args[i] == "--realtime")
+            realtime = true;
+        else if (args[i] == "-c" && i + 1 < args.size())
+            config = args[++i];
+        else
+            recording = args[i].toStdString();
+    }
+    confInit(config);
+
+    std::vector<struct toplevel_batch> batches;
+    if (recording.empty()) {
+        batches = synthesize();
+    } else if (!toplevelRecordLoad(recording, &batches)) {
+        std::println(stderr, "cannot load recording '{}'", recording);
+        return 1;
+    }
+
+    struct sfdo sfdo;
+    desktopEntryInit(&sfdo);
+    iconCacheSetLimit((size_t)conf.icon_cache_size * 1024);
+
+    QGraphicsScene scene;
+    CountingView view(&scene);
+    view.setFixedSize(PANEL_WIDTH, conf.panel_height);
+    view.setSceneRect(0, 0, PANEL_WIDTH, conf.panel_height);
+    ToplevelReplay replay;
+    auto taskbar = new Taskbar(&scene, conf.panel_height, PANEL_WIDTH, &sfdo, &replay, nullptr);
+    scene.addItem(taskbar);
+    view.show();
+    settle();
+    view.repaints = 0;
+
+    std::vector<double> event_us;
+    uint64_t events = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (auto &batch : batches) {
+        if (realtime)
+            std::this_thread::sleep_until(start + batch.time);
+        size_t count = batch.updates.size();
+        auto t0 = std::chrono::steady_clock::now();
+        replay.deliver(batch.updates);
+        settle();
+        std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - t0;
+        if (count) {
+            events += count;
+            event_us.push_back(elapsed.count() / count);
+        }
+    }
+    std::chrono::duration<double, std::milli> total = std::chrono::steady_clock::now() - start;
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    std::println("batches\t{}", batches.size());
+    std::println("events\t{}", events);
+    std::println("total_ms\t{:.1f}", total.count());
+    std::println("event_us_median\t{:.1f}", benchPercentile(event_us, 0.5));
+    std::println("event_us_p99\t{:.1f}", benchPercentile(event_us, 0.99));
+    std::println("event_us_max\t{:.1f}", benchPercentile(event_us, 1.0));
+    std::println("repaints\t{}", view.repaints);
+    std::println("peak_rss_kb\t{}", usage.ru_maxrss);
+
+    scene.clear();
+    iconCacheFinish();
+    desktopEntryFinish(&sfdo);
+    return 0;
+}
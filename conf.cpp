@@ -1,12 +1,17 @@
 // SPDX-License-Identifier: GPL-2.0-only
+#include <algorithm>
+#include <array>
+#include <charconv>
 #include <fstream>
+#include <iterator>
 #include <memory>
 #include <ranges>
-#include <regex>
 #include <string>
+#include <string_view>
 #include <vector>
 #include "conf.h"
 #include "log.h"
+#include "render-style.h"
 
 struct conf conf;
 
@@ -19,142 +24,236 @@ Background::Background(void)
 
 Background::~Background(void) { };
 
-static int current_background_index = 0;
+/* Where a value was read from, for diagnostics */
+struct location {
+    std::string_view file;
+    int line;
+};
 
-static std::vector<std::string> split(const std::string &s, char delim)
+static std::string_view trim(std::string_view s)
 {
-    auto has_content = [](auto const &s) { return s.size() > 0; };
-    auto parts = s | std::views::split(delim) | std::views::filter(has_content)
-            | std::ranges::to<std::vector<std::string>>();
-    return parts;
+    size_t first = s.find_first_not_of(" \t\r");
+    if (first == std::string_view::npos)
+        return {};
+    return s.substr(first, s.find_last_not_of(" \t\r") - first + 1);
 }
 
-static QColor getColor(std::string value)
+/* Stores the first N space separated words of @value in @words; returns how many there are */
+template<size_t N>
+static size_t split(std::string_view value, std::array<std::string_view, N> &words)
 {
-    auto parts = split(value, ' ');
-    if (parts.size() != 2)
-        die("incorrect color syntax '{}'; expected '#rrggbb aaa'", value);
-    std::string rrggbb = parts.at(0).erase(0, 1);
-    std::string aa = std::format("{:x}", 255 * std::stoi(parts.at(1)) / 100);
-    if (aa.length() != 2)
-        aa.insert(0, "0");
-    std::string color = "#" + aa + rrggbb;
-    return QColor(QString::fromStdString(color));
+    size_t count = 0;
+    for (size_t pos = value.find_first_not_of(' '); pos != std::string_view::npos;
+         pos = value.find_first_not_of(' ', pos)) {
+        size_t end = std::min(value.find(' ', pos), value.size());
+        if (count < N)
+            words[count] = value.substr(pos, end - pos);
+        count++;
+        pos = end;
+    }
+    return count;
+}
+
+static int parse_number(const struct location &loc, std::string_view value, int base = 10)
+{
+    int number = 0;
+    auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), number, base);
+    if (error != std::errc() || end != value.data() + value.size())
+        die("{}:{}: '{}' is not a number", loc.file, loc.line, value);
+    return number;
+}
+
+static int parse_int(const struct location &loc, std::string_view value)
+{
+    return parse_number(loc, value);
+}
+
+static std::string parse_string(const struct location &loc, std::string_view value)
+{
+    return std::string(value);
+}
+
+static QColor parse_color(const struct location &loc, std::string_view value)
+{
+    std::array<std::string_view, 2> parts;
+    if (split(value, parts) != 2 || parts[0].size() != 7 || parts[0][0] != '#')
+        die("{}:{}: incorrect color syntax '{}'; expected '#rrggbb aaa'", loc.file, loc.line,
+            value);
+    int rgb = parse_number(loc, parts[0].substr(1), 16);
+    int opacity = parse_number(loc, parts[1]);
+    if (opacity < 0 || opacity > 100)
+        die("{}:{}: opacity '{}' out of range; expected 0 to 100", loc.file, loc.line, opacity);
+    return QColor((rgb >> 16) & 0xff, (rgb >> 8) & 0xff, rgb & 0xff, 255 * opacity / 100);
 }
 
-static QFont getFont(std::string value)
+static QFont parse_font(const struct location &loc, std::string_view value)
 {
-    auto parts = split(value, ' ');
-    if (parts.size() != 3)
-        die("incorrect font syntax '{}'; expected '[family] [style] [size]'", value);
+    std::array<std::string_view, 3> parts;
+    if (split(value, parts) != 3)
+        die("{}:{}: incorrect font syntax '{}'; expected '[family] [style] [size]'", loc.file,
+            loc.line, value);
     QFont font;
-    font.setFamily(QString::fromStdString(parts.at(0)));
-    font.setPointSize(std::stoi(parts.at(2)));
+    font.setFamily(QString::fromUtf8(parts[0].data(), parts[0].size()));
+    font.setPointSize(parse_number(loc, parts[2]));
     return font;
 }
 
-static struct padding getPadding(std::string value)
+static struct padding parse_padding(const struct location &loc, std::string_view value)
 {
-    auto parts = split(value, ' ');
-    if (parts.size() != 3)
-        die("incorrect padding syntax '{}'; expected '[horizontal] [vertical] [spacing]'", value);
+    std::array<std::string_view, 3> parts;
+    if (split(value, parts) != 3)
+        die("{}:{}: incorrect padding syntax '{}'; expected '[horizontal] [vertical] [spacing]'",
+            loc.file, loc.line, value);
     struct padding padding{
-        .horizontal = std::stoi(parts.at(0)),
-        .vertical = std::stoi(parts.at(1)),
-        .spacing = std::stoi(parts.at(2)),
+        .horizontal = parse_number(loc, parts[0]),
+        .vertical = parse_number(loc, parts[1]),
+        .spacing = parse_number(loc, parts[2]),
     };
     return padding;
 }
 
-std::string trim(std::string s)
+static int parse_background_id(const struct location &loc, std::string_view value)
 {
-    return regex_replace(s, std::regex("(^[ ]+)|([ ]+$)"), "");
+    int id = parse_number(loc, value);
+    if (id < 0 || (size_t)id >= conf.backgrounds.size())
+        die("{}:{}: background_id '{}' not defined", loc.file, loc.line, id);
+    return id;
 }
 
-uint32_t getBackgroundId(std::string value)
+/* Keys whose value maps directly onto a field of the configuration */
+template<auto field, auto parse>
+static void set_field(const struct location &loc, std::string_view value)
 {
-    uint32_t id = std::stoi(value);
-    if (id > conf.backgrounds.size() - 1)
-        die("background_id '{}' not defined", id);
-    return id;
+    conf.*field = parse(loc, value);
 }
 
-static void process_line(const std::string &line)
+static void set_panel_items(const struct location &loc, std::string_view value)
 {
-    auto hunks = line | std::views::split('=') | std::ranges::to<std::vector<std::string>>();
-    if (hunks.size() < 2) {
+    size_t t = value.find('T');
+    if (t == std::string_view::npos)
+        die("{}:{}: no 'T' in panel_items", loc.file, loc.line);
+    conf.panel_items_left = value.substr(0, t);
+    conf.panel_items_right = value.substr(t + 1);
+}
+
+static void set_panel_size(const struct location &loc, std::string_view value)
+{
+    std::array<std::string_view, 2> parts;
+    if (split(value, parts) != 2)
+        die("{}:{}: incorrect syntax 'panel_size={}'; expected two space separated values",
+            loc.file, loc.line, value);
+    conf.panel_height = parse_number(loc, parts[1]);
+}
+
+static void set_panel_outputs(const struct location &loc, std::string_view value)
+{
+    conf.panel_outputs.clear();
+    if (value == "all")
         return;
+    for (auto output : value | std::views::split(' ')) {
+        if (!output.empty())
+            conf.panel_outputs.emplace_back(output.begin(), output.end());
     }
+}
 
-    auto key = trim(hunks[0]);
-    auto value = trim(hunks[1]);
+static void set_task_maximum_size(const struct location &loc, std::string_view value)
+{
+    std::array<std::string_view, 2> parts;
+    if (split(value, parts) != 2)
+        die("{}:{}: incorrect syntax 'task_maximum_size={}'; expected two space separated values",
+            loc.file, loc.line, value);
+    conf.task_maximum_size = parse_number(loc, parts[0]);
+}
 
-    // Panel
-    if (key == "panel_items") {
-        if (!value.contains("T"))
-            die("no 'T' in panel_items");
-        auto parts = value | std::views::split('T') | std::ranges::to<std::vector<std::string>>();
-        conf.panel_items_left = parts.at(0);
-        conf.panel_items_right = parts.at(1);
-    } else if (key == "panel_size") {
-        auto parts = split(value, ' ');
-        if (parts.size() != 2)
-            die("incorrect syntax '{}={}'; expected two space separated values", key, value);
-        conf.panel_height = std::stoi(parts.at(1));
-    } else if (key == "panel_background_id") {
-        conf.panel_background_id = getBackgroundId(value);
-
-        // Taskbar
-    } else if (key == "taskbar_background_id") {
-        conf.taskbar_background_id = getBackgroundId(value);
-    } else if (key == "taskbar_padding") {
-        conf.taskbar_padding = getPadding(value);
-
-        // Task
-    } else if (key == "task_maximum_size") {
-        auto parts = split(value, ' ');
-        if (parts.size() != 2)
-            die("incorrect syntax '{}={}'; expected two space separated values", key, value);
-        conf.task_maximum_size = std::stoi(parts.at(0));
-    } else if (key == "task_font") {
-        conf.task_font = getFont(value);
-    } else if (key == "task_font_color") {
-        conf.task_font_color = getColor(value);
-    } else if (key == "task_background_id") {
-        conf.task_background_id = getBackgroundId(value);
-    } else if (key == "task_active_background_id") {
-        conf.task_active_background_id = getBackgroundId(value);
-
-        // Clock
-    } else if (key == "clock_background_id") {
-        conf.clock_background_id = getBackgroundId(value);
-    } else if (key == "time1_font") {
-        conf.time1_font = getFont(value);
-    } else if (key == "clock_font_color") {
-        conf.clock_font_color = getColor(value);
-
-        // Backgrounds
-    } else if (key == "rounded") {
-        // 'rounded' is special because it defines the start of a background object section
-        conf.backgrounds.push_back(std::make_unique<Background>());
-        ++current_background_index;
-        conf.backgrounds.at(current_background_index)->rounded = std::stoi(value);
-    } else if (key == "background_color") {
-        conf.backgrounds.at(current_background_index)->background_color = getColor(value);
-    } else if (key == "border_color") {
-        conf.backgrounds.at(current_background_index)->border_color = getColor(value);
+/* 'rounded' is special because it defines the start of a background object section */
+static void set_rounded(const struct location &loc, std::string_view value)
+{
+    conf.backgrounds.push_back(std::make_unique<Background>());
+    conf.backgrounds.back()->rounded = parse_number(loc, value);
+}
+
+static void set_background_color(const struct location &loc, std::string_view value)
+{
+    conf.backgrounds.back()->background_color = parse_color(loc, value);
+}
+
+static void set_border_color(const struct location &loc, std::string_view value)
+{
+    conf.backgrounds.back()->border_color = parse_color(loc, value);
+}
+
+struct conf_key {
+    std::string_view name;
+    void (*set)(const struct location &loc, std::string_view value);
+};
+
+/* Sorted by name, for binary search */
+static constexpr struct conf_key keys[] = {
+    { "background_color", set_background_color },
+    { "border_color", set_border_color },
+    { "clock_background_id", set_field<&conf::clock_background_id, parse_background_id> },
+    { "clock_font_color", set_field<&conf::clock_font_color, parse_color> },
+    { "icon_cache_size", set_field<&conf::icon_cache_size, parse_int> },
+    { "panel_background_id", set_field<&conf::panel_background_id, parse_background_id> },
+    { "panel_items", set_panel_items },
+    { "panel_outputs", set_panel_outputs },
+    { "panel_size", set_panel_size },
+    { "rounded", set_rounded },
+    { "task_active_background_id",
+      set_field<&conf::task_active_background_id, parse_background_id> },
+    { "task_background_id", set_field<&conf::task_background_id, parse_background_id> },
+    { "task_font", set_field<&conf::task_font, parse_font> },
+    { "task_font_color", set_field<&conf::task_font_color, parse_color> },
+    { "task_maximum_size", set_task_maximum_size },
+    { "task_minimum_size", set_field<&conf::task_minimum_size, parse_int> },
+    { "taskbar_background_id", set_field<&conf::taskbar_background_id, parse_background_id> },
+    { "taskbar_grouping", set_field<&conf::taskbar_grouping, parse_int> },
+    { "taskbar_padding", set_field<&conf::taskbar_padding, parse_padding> },
+    { "time1_font", set_field<&conf::time1_font, parse_font> },
+    { "time1_format", set_field<&conf::time1_format, parse_string> },
+    { "time2_font", set_field<&conf::time2_font, parse_font> },
+    { "time2_format", set_field<&conf::time2_format, parse_string> },
+};
+static_assert(std::ranges::is_sorted(keys, {}, &conf_key::name));
+
+void confParse(std::string_view text, std::string_view filename)
+{
+    struct location loc = { filename, 0 };
+    while (!text.empty()) {
+        size_t eol = std::min(text.find('\n'), text.size());
+        std::string_view line = trim(text.substr(0, eol));
+        text.remove_prefix(std::min(eol + 1, text.size()));
+        loc.line++;
+
+        if (line.empty() || line.front() == '#')
+            continue;
+        // Only the first '=' separates key and value; time formats may contain more
+        size_t equals = line.find('=');
+        if (equals == std::string_view::npos) {
+            warn("{}:{}: expected 'key = value'", loc.file, loc.line);
+            continue;
+        }
+        std::string_view key = trim(line.substr(0, equals));
+        std::string_view value = trim(line.substr(equals + 1));
+
+        auto it = std::ranges::lower_bound(keys, key, {}, &conf_key::name);
+        if (it == std::end(keys) || it->name != key) {
+            warn("{}:{}: unknown key '{}'", loc.file, loc.line, key);
+            continue;
+        }
+        it->set(loc, value);
     }
 }
 
-static void parse(std::string filename)
+static void parse(const std::string &filename)
 {
-    std::ifstream file(filename);
-    std::string line;
-    if (!file.is_open())
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
         warn("cannot open file '{}'", filename);
-    while (std::getline(file, line))
-        process_line(line);
-    file.close();
+        return;
+    }
+    std::string text(std::istreambuf_iterator<char>(file), {});
+    confParse(text, filename);
 }
 
 void confInit(QString filename)
@@ -166,24 +265,35 @@ void confInit(QString filename)
 
     // Taskbar
     conf.taskbar_padding = { 0 };
+    conf.taskbar_grouping = 0;
 
+    conf.task_minimum_size = 0;
     conf.task_font = QFont("Sans", 10);
     conf.task_font_color = QColor("#ffffff");
 
     // Clock
+    conf.time1_format = "%H:%M";
+    conf.time2_format = "";
     conf.time1_font = QFont("Sans", 10);
+    conf.time2_font = QFont("Sans", 8);
     conf.clock_font_color = QColor("#ffffff");
 
+    // Icons
+    conf.icon_cache_size = 2048;
+
     // Temporary global settings
     conf.penWidth = 1.0;
     conf.verbosity = 0;
 
     // background_id 0 refers to a special background which is fully transparent
+    conf.backgrounds.clear();
     conf.backgrounds.push_back(std::make_unique<Background>());
 
     // TOOD: Init all background values
 
     parse(filename.toStdString());
+    renderStylesInit();
+    ++conf.generation;
 }
 
 void confSetOutput(QString output)
@@ -195,3 +305,23 @@ void confSetVerbosity(int verbosity)
 {
     conf.verbosity = verbosity;
 }
+
+void confSetRecordToplevels(QString filename)
+{
+    conf.record_toplevels = filename.toStdString();
+}
+
+void confSetRenderer(QString renderer)
+{
+    if (renderer.isEmpty() || renderer == "scene")
+        conf.renderer = RENDERER_SCENE;
+    else if (renderer == "raster")
+        conf.renderer = RENDERER_RASTER;
+    else
+        die("unknown renderer '{}'; expected 'scene' or 'raster'", renderer.toStdString());
+}
+
+void confSetStats(bool stats)
+{
+    conf.stats = stats;
+}
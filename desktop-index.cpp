@@ -0,0 +1,264 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "desktop-index.h"
+
+static constexpr size_t NO_MATCH = SIZE_MAX;
+
+/* A desktop file which changed after the database was loaded */
+struct desktop_override {
+    bool removed;
+    // Position of the data directory the file is in, lower is more important
+    int precedence;
+    std::string icon;
+    // Folded like the lookup tables below
+    std::string base;
+    std::string wm_class;
+};
+
+struct desktop_index {
+    // Entries in database order; a lower position wins when several entries match
+    std::vector<struct sfdo_desktop_entry *> entries;
+
+    // Folded desktop ID basename or StartupWMClass -> position of the first entry using it
+    std::unordered_map<std::string, size_t> by_base;
+    std::unordered_map<std::string, size_t> by_wm_class;
+
+    // Folded basenames in sorted order with a sparse table of minimum positions over them, so
+    // that the first entry whose basename starts with an app_id is found in O(log n)
+    std::vector<std::string> sorted_bases;
+    std::vector<std::vector<size_t>> min_position;
+
+    // Folded app_ids known not to match any entry
+    std::unordered_set<std::string> misses;
+
+    // Desktop ID -> re-read entry; these take precedence over the database
+    std::unordered_map<std::string, struct desktop_override> overrides;
+    struct sfdo_desktop_db *db;
+};
+
+static std::string fold(const char *s)
+{
+    std::string folded(s);
+    for (auto &c : folded)
+        c = (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+    return folded;
+}
+
+/* Get portion of desktop ID after last '.' */
+static const char *desktop_id_base(const char *desktop_id)
+{
+    const char *dot = strrchr(desktop_id, '.');
+    return dot ? (dot + 1) : desktop_id;
+}
+
+static const char *desktop_id_base(struct sfdo_desktop_entry *entry)
+{
+    return desktop_id_base(sfdo_desktop_entry_get_id(entry, NULL));
+}
+
+struct desktop_index *desktopIndexCreate(struct sfdo_desktop_db *db)
+{
+    auto index = new desktop_index;
+    index->db = db;
+
+    size_t n_entries;
+    struct sfdo_desktop_entry **entries = sfdo_desktop_db_get_entries(db, &n_entries);
+    index->entries.assign(entries, entries + n_entries);
+
+    std::vector<std::pair<std::string, size_t>> bases;
+    for (size_t i = 0; i < n_entries; i++) {
+        struct sfdo_desktop_entry *entry = entries[i];
+        std::string base = fold(desktop_id_base(entry));
+        index->by_base.emplace(base, i);
+        bases.emplace_back(std::move(base), i);
+
+        /* sfdo_desktop_entry_get_startup_wm_class() asserts against APPLICATION */
+        if (sfdo_desktop_entry_get_type(entry) != SFDO_DESKTOP_ENTRY_APPLICATION)
+            continue;
+        const char *wm_class = sfdo_desktop_entry_get_startup_wm_class(entry, NULL);
+        if (wm_class)
+            index->by_wm_class.emplace(fold(wm_class), i);
+    }
+
+    std::ranges::sort(bases);
+    std::vector<size_t> level;
+    for (auto &[base, i] : bases) {
+        index->sorted_bases.push_back(std::move(base));
+        level.push_back(i);
+    }
+    index->min_position.push_back(std::move(level));
+    for (size_t width = 2; width <= n_entries; width *= 2) {
+        auto &prev = index->min_position.back();
+        std::vector<size_t> next(n_entries - width + 1);
+        for (size_t i = 0; i < next.size(); i++)
+            next[i] = std::min(prev[i], prev[i + width / 2]);
+        index->min_position.push_back(std::move(next));
+    }
+    return index;
+}
+
+void desktopIndexDestroy(struct desktop_index *index)
+{
+    delete index;
+}
+
+static size_t find(const std::unordered_map<std::string, size_t> &map, const std::string &key)
+{
+    auto it = map.find(key);
+    return it == map.end() ? NO_MATCH : it->second;
+}
+
+/* Minimum entry position over sorted_bases[first, last) */
+static size_t range_min(struct desktop_index *index, size_t first, size_t last)
+{
+    if (first >= last)
+        return NO_MATCH;
+    int k = std::bit_width(last - first) - 1;
+    auto &level = index->min_position.at(k);
+    return std::min(level[first], level[last - (size_t(1) << k)]);
+}
+
+static bool overridden(struct desktop_index *index, size_t position)
+{
+    return position != NO_MATCH
+            && index->overrides.contains(sfdo_desktop_entry_get_id(index->entries[position], NULL));
+}
+
+/* Of several matching overrides, the one in the most important data directory wins */
+static bool match_overrides(struct desktop_index *index, const std::string &key, bool partial,
+                            std::string *icon)
+{
+    const std::string *best_id = nullptr;
+    const struct desktop_override *best = nullptr;
+    for (auto &[desktop_id, entry] : index->overrides) {
+        if (entry.removed)
+            continue;
+        bool match = partial ? key.starts_with(entry.base) || entry.base.starts_with(key)
+                             : key == entry.base || key == entry.wm_class;
+        if (match
+            && (!best || std::tie(entry.precedence, desktop_id)
+                                 < std::tie(best->precedence, *best_id))) {
+            best_id = &desktop_id;
+            best = &entry;
+        }
+    }
+    if (best)
+        *icon = best->icon;
+    return best;
+}
+
+static bool match_entry(struct desktop_index *index, size_t position, std::string *icon)
+{
+    if (position == NO_MATCH || overridden(index, position))
+        return false;
+    const char *name = sfdo_desktop_entry_get_icon(index->entries[position], NULL);
+    icon->assign(name ? name : "");
+    return true;
+}
+
+bool desktopIndexLookup(struct desktop_index *index, const char *app_id, std::string *icon)
+{
+    auto it = index->overrides.find(app_id);
+    if (it != index->overrides.end() && !it->second.removed) {
+        *icon = it->second.icon;
+        return true;
+    }
+    if (it == index->overrides.end()) {
+        struct sfdo_desktop_entry *entry =
+                sfdo_desktop_db_get_entry_by_id(index->db, app_id, SFDO_NT);
+        if (entry) {
+            const char *name = sfdo_desktop_entry_get_icon(entry, NULL);
+            icon->assign(name ? name : "");
+            return true;
+        }
+    }
+
+    std::string key = fold(app_id);
+    if (index->misses.contains(key))
+        return false;
+
+    if (match_overrides(index, key, /* partial */ false, icon))
+        return true;
+    size_t match = std::min(find(index->by_base, key), find(index->by_wm_class, key));
+    if (match_entry(index, match, icon))
+        return true;
+
+    /*
+     * Try matching partial strings - catches GIMP, among others. An entry matches when either
+     * its desktop ID basename or the app_id is a prefix of the other.
+     */
+    for (size_t len = 0; len < key.size(); len++)
+        match = std::min(match, find(index->by_base, key.substr(0, len)));
+
+    auto first = std::ranges::lower_bound(index->sorted_bases, key);
+    auto last = std::ranges::partition_point(first, index->sorted_bases.end(),
+                                             [&](const std::string &base) {
+                                                 return base.starts_with(key);
+                                             });
+    match = std::min(match, range_min(index, first - index->sorted_bases.begin(),
+                                      last - index->sorted_bases.begin()));
+
+    if (match_overrides(index, key, /* partial */ true, icon) || match_entry(index, match, icon))
+        return true;
+
+    index->misses.insert(std::move(key));
+    return false;
+}
+
+static std::string strip(const std::string &s)
+{
+    size_t first = s.find_first_not_of(" \t");
+    if (first == std::string::npos)
+        return "";
+    return s.substr(first, s.find_last_not_of(" \t\r") - first + 1);
+}
+
+/* Read the few keys tint cares about from the [Desktop Entry] group */
+static void parse_desktop_file(const std::string &path, struct desktop_override *entry)
+{
+    std::ifstream file(path);
+    std::string line;
+    bool in_group = false;
+    entry->removed = !file.is_open();
+    while (std::getline(file, line)) {
+        if (line.starts_with('[')) {
+            in_group = line == "[Desktop Entry]";
+            continue;
+        }
+        size_t eq = line.find('=');
+        if (!in_group || eq == std::string::npos)
+            continue;
+        std::string key = strip(line.substr(0, eq));
+        std::string value = strip(line.substr(eq + 1));
+        if (key == "Icon")
+            entry->icon = value;
+        else if (key == "StartupWMClass")
+            entry->wm_class = fold(value.c_str());
+        else if (key == "Hidden" && value == "true")
+            entry->removed = true;
+    }
+}
+
+void desktopIndexReload(struct desktop_index *index, const std::string &desktop_id,
+                        const std::string &path, int precedence)
+{
+    struct desktop_override entry = {
+        .removed = path.empty(),
+        .precedence = precedence,
+        .base = fold(desktop_id_base(desktop_id.c_str())),
+    };
+    if (!entry.removed)
+        parse_desktop_file(path, &entry);
+    index->overrides[desktop_id] = std::move(entry);
+
+    // A new entry may match app_ids which previously matched nothing
+    index->misses.clear();
+}
@@ -0,0 +1,37 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <utility>
+#include "frame-scheduler.h"
+
+static uint64_t committed_count;
+static uint64_t coalesced_count;
+
+FrameScheduler::FrameScheduler(QWindow *window) : m_window{ window }, m_pending{ false } { }
+
+void FrameScheduler::invalidate(const QRect &rect)
+{
+    m_damage += rect;
+    if (m_pending) {
+        ++coalesced_count;
+        return;
+    }
+    m_pending = true;
+    m_window->requestUpdate();
+}
+
+QRegion FrameScheduler::take(void)
+{
+    m_pending = false;
+    if (!m_damage.isEmpty())
+        ++committed_count;
+    return std::exchange(m_damage, QRegion());
+}
+
+uint64_t frameCommittedCount(void)
+{
+    return committed_count;
+}
+
+uint64_t frameCoalescedCount(void)
+{
+    return coalesced_count;
+}
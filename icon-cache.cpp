@@ -0,0 +1,250 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <algorithm>
+#include <atomic>
+#include <format>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <QCoreApplication>
+#include <QThread>
+#include <QThreadPool>
+#include "conf.h"
+#include "icon-cache.h"
+#include "icon-loader.h"
+#include "log.h"
+
+struct icon_cache_entry {
+    std::string key;
+    struct icon_lookup lookup;
+    QPixmap pixmap;
+    size_t bytes;
+};
+
+/* Requests for one key which are waiting for a worker */
+struct icon_job {
+    std::vector<icon_ticket> tickets;
+    // Read by the worker to skip jobs whose requesters have all gone away
+    std::shared_ptr<std::atomic<bool>> cancelled;
+};
+
+struct icon_request {
+    std::string key;
+    icon_callback callback;
+};
+
+static struct {
+    // Most recently used entries at the front
+    std::list<struct icon_cache_entry> lru;
+    std::unordered_map<std::string, std::list<struct icon_cache_entry>::iterator> map;
+    size_t limit = 2048 * 1024;
+    struct icon_cache_stats stats;
+
+    std::unordered_map<std::string, struct icon_job> jobs;
+    std::unordered_map<icon_ticket, struct icon_request> requests;
+    icon_ticket next_ticket = 1;
+    QThreadPool *pool;
+
+    std::unordered_map<void *, std::pair<icon_lookups_handler, icon_invalidate_handler>> handlers;
+} cache;
+
+/* List and hash map nodes of an entry, besides the entry itself */
+static constexpr size_t ENTRY_OVERHEAD = 4 * sizeof(void *) + sizeof(std::string);
+
+/*
+ * Entries without an icon are charged for their bookkeeping too, so that a stream of distinct
+ * icon-less app_ids is evicted like everything else instead of growing the map without bound.
+ */
+static size_t entry_bytes(const std::string &key, const struct icon_lookup &lookup,
+                          const QPixmap &pixmap)
+{
+    size_t bytes = sizeof(struct icon_cache_entry) + ENTRY_OVERHEAD + 2 * key.size()
+            + lookup.app_id.size();
+    if (!pixmap.isNull())
+        bytes += (size_t)pixmap.width() * pixmap.height() * pixmap.depth() / 8;
+    return bytes;
+}
+
+static void evict(void)
+{
+    while (cache.stats.bytes > cache.limit && !cache.lru.empty()) {
+        auto &entry = cache.lru.back();
+        cache.stats.bytes -= entry.bytes;
+        cache.map.erase(entry.key);
+        cache.lru.pop_back();
+    }
+}
+
+static void insert(const std::string &key, const struct icon_lookup &lookup, const QPixmap &pixmap)
+{
+    size_t bytes = entry_bytes(key, lookup, pixmap);
+    cache.lru.push_front({ .key = key, .lookup = lookup, .pixmap = pixmap, .bytes = bytes });
+    cache.map.emplace(key, cache.lru.begin());
+    cache.stats.bytes += bytes;
+    evict();
+}
+
+static std::string make_key(const std::string &app_id, int size, qreal dpr)
+{
+    return std::format("{}\n{}\n{}", app_id, size, dpr);
+}
+
+/* Runs on a worker thread; only QImage may be used here */
+static QImage load(struct sfdo *sfdo, const std::string &app_id, int size, qreal dpr)
+{
+    std::string name = load_icon_from_app_id(sfdo, app_id.c_str(), size, dpr);
+    if (name.empty())
+        return QImage();
+    QImage image = loadIconImage(name, qRound(size * dpr));
+    image.setDevicePixelRatio(dpr);
+    return image;
+}
+
+/* Runs on the GUI thread once a worker has finished */
+static void deliver(const std::string &key, const struct icon_lookup &lookup, const QImage &image)
+{
+    auto it = cache.jobs.find(key);
+    if (it == cache.jobs.end())
+        return;
+    std::vector<icon_ticket> tickets = std::move(it->second.tickets);
+    cache.jobs.erase(it);
+
+    // Icon-less apps are cached too so that they do not hit the disk again
+    QPixmap pixmap = image.isNull() ? QPixmap() : QPixmap::fromImage(image);
+    insert(key, lookup, pixmap);
+
+    for (icon_ticket ticket : tickets) {
+        auto request = cache.requests.find(ticket);
+        if (request == cache.requests.end())
+            continue;
+        icon_callback callback = std::move(request->second.callback);
+        cache.requests.erase(request);
+        callback(pixmap);
+    }
+}
+
+icon_ticket iconCacheRequest(struct sfdo *sfdo, const std::string &app_id, int size, qreal dpr,
+                             icon_callback callback)
+{
+    std::string key = make_key(app_id, size, dpr);
+
+    auto it = cache.map.find(key);
+    if (it != cache.map.end()) {
+        ++cache.stats.hits;
+        cache.lru.splice(cache.lru.begin(), cache.lru, it->second);
+        callback(it->second->pixmap);
+        return 0;
+    }
+    ++cache.stats.misses;
+
+    icon_ticket ticket = cache.next_ticket++;
+    cache.requests.emplace(ticket, icon_request{ .key = key, .callback = std::move(callback) });
+
+    // Windows of the same app opened in a burst share a single job
+    auto job = cache.jobs.find(key);
+    if (job != cache.jobs.end()) {
+        job->second.tickets.push_back(ticket);
+        return ticket;
+    }
+    auto cancelled = std::make_shared<std::atomic<bool>>(false);
+    cache.jobs.emplace(key, icon_job{ .tickets = { ticket }, .cancelled = cancelled });
+
+    if (!cache.pool) {
+        cache.pool = new QThreadPool;
+        cache.pool->setMaxThreadCount(std::clamp(QThread::idealThreadCount(), 1, 4));
+    }
+    cache.pool->start([=]() {
+        if (cancelled->load())
+            return;
+        QImage image = load(sfdo, app_id, size, dpr);
+        struct icon_lookup lookup = { .app_id = app_id, .size = size, .scale = (float)dpr };
+        QMetaObject::invokeMethod(
+                qApp, [=]() { deliver(key, lookup, image); }, Qt::QueuedConnection);
+    });
+    return ticket;
+}
+
+void iconCacheCancel(icon_ticket ticket)
+{
+    auto request = cache.requests.find(ticket);
+    if (request == cache.requests.end())
+        return;
+    auto job = cache.jobs.find(request->second.key);
+    cache.requests.erase(request);
+    if (job == cache.jobs.end())
+        return;
+
+    std::erase(job->second.tickets, ticket);
+    if (job->second.tickets.empty()) {
+        job->second.cancelled->store(true);
+        cache.jobs.erase(job);
+    }
+}
+
+std::vector<struct icon_lookup> iconCacheLookups(void)
+{
+    std::vector<struct icon_lookup> lookups;
+    for (auto &entry : cache.lru)
+        lookups.push_back(entry.lookup);
+    for (auto &[owner, handler] : cache.handlers)
+        handler.first(&lookups);
+
+    std::unordered_set<std::string> seen;
+    std::erase_if(lookups, [&](const struct icon_lookup &lookup) {
+        return !seen.insert(make_key(lookup.app_id, lookup.size, lookup.scale)).second;
+    });
+    return lookups;
+}
+
+void iconCacheInvalidate(const std::unordered_set<std::string> &app_ids)
+{
+    for (auto it = cache.lru.begin(); it != cache.lru.end();) {
+        if (app_ids.contains(it->lookup.app_id)) {
+            cache.stats.bytes -= it->bytes;
+            cache.map.erase(it->key);
+            it = cache.lru.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (auto &[owner, handler] : cache.handlers)
+        handler.second(app_ids);
+}
+
+void iconCacheAddInvalidateHandler(void *owner, icon_lookups_handler lookups,
+                                   icon_invalidate_handler handler)
+{
+    cache.handlers[owner] = { std::move(lookups), std::move(handler) };
+}
+
+void iconCacheRemoveInvalidateHandler(void *owner)
+{
+    cache.handlers.erase(owner);
+}
+
+void iconCacheSetLimit(size_t bytes)
+{
+    cache.limit = bytes;
+    evict();
+}
+
+void iconCacheFinish(void)
+{
+    for (auto &[key, job] : cache.jobs)
+        job.cancelled->store(true);
+    cache.jobs.clear();
+    cache.requests.clear();
+    if (cache.pool) {
+        cache.pool->waitForDone();
+        delete cache.pool;
+        cache.pool = nullptr;
+    }
+    cache.lru.clear();
+    cache.map.clear();
+    cache.stats.bytes = 0;
+}
+
+struct icon_cache_stats iconCacheStats(void)
+{
+    return cache.stats;
+}
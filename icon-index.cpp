@@ -0,0 +1,318 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "conf.h"
+#include "icon-index.h"
+#include "log.h"
+#include "resources.h"
+
+/*
+ * On-disk layout (host endianness, the file is never shared between machines):
+ *
+ *   header
+ *   record[count]        sorted by hash
+ *   string blob          keys and paths referenced by offset from the start of the blob
+ */
+static constexpr char INDEX_MAGIC[8] = { 'T', 'I', 'N', 'T', 'I', 'D', 'X', '1' };
+
+struct index_header {
+    char magic[8];
+    uint64_t fingerprint;
+    uint32_t count;
+    uint32_t blob_size;
+};
+
+struct index_record {
+    uint64_t hash;
+    uint32_t key_offset;
+    uint32_t key_length;
+    uint32_t path_offset;
+    uint32_t path_length;
+};
+
+static struct {
+    std::string theme;
+    std::string filename;
+    uint64_t fingerprint;
+
+    // Read-only mapping of the index file written by a previous run
+    const unsigned char *map;
+    size_t map_size;
+    const struct index_record *records;
+    uint32_t count;
+    const char *blob;
+
+    // Entries resolved during this run
+    std::unordered_map<std::string, std::string> added;
+
+    struct icon_index_stats stats;
+} icon_index;
+
+static uint64_t fnv1a(const void *data, size_t len, uint64_t hash = 0xcbf29ce484222325ULL)
+{
+    auto p = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < len; i++) {
+        hash ^= p[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static std::string make_key(const char *app_id, int size, float scale)
+{
+    return std::format("{}\n{}\n{}\n{}", icon_index.theme, size, scale, app_id);
+}
+
+static std::string env_or(const char *name, const std::string &fallback)
+{
+    const char *value = getenv(name);
+    return value && *value ? std::string(value) : fallback;
+}
+
+/*
+ * Directories whose contents decide what an app_id resolves to. Installing or removing a
+ * .desktop file or an icon theme touches at least one of them (package managers also refresh
+ * icon-theme.cache), so hashing their mtimes is enough to detect a stale index.
+ */
+static std::vector<std::string> watched_paths(void)
+{
+    std::string home = env_or("HOME", "");
+    std::vector<std::string> paths;
+    for (auto &dir : xdgDataDirs()) {
+        paths.push_back(dir + "/applications");
+        paths.push_back(dir + "/icons");
+        paths.push_back(dir + "/icons/" + icon_index.theme);
+        paths.push_back(dir + "/icons/" + icon_index.theme + "/icon-theme.cache");
+        paths.push_back(dir + "/icons/hicolor");
+        paths.push_back(dir + "/icons/hicolor/icon-theme.cache");
+    }
+    paths.push_back(home + "/.icons");
+    paths.push_back("/usr/share/pixmaps");
+    return paths;
+}
+
+static uint64_t compute_fingerprint(void)
+{
+    uint64_t hash = fnv1a(icon_index.theme.data(), icon_index.theme.size());
+    for (auto &path : watched_paths()) {
+        struct stat st;
+        int64_t stamp[2] = { -1, -1 };
+        if (!stat(path.c_str(), &st)) {
+            stamp[0] = st.st_mtim.tv_sec;
+            stamp[1] = st.st_mtim.tv_nsec;
+        }
+        hash = fnv1a(path.data(), path.size(), hash);
+        hash = fnv1a(stamp, sizeof(stamp), hash);
+    }
+    return hash;
+}
+
+static void unmap_index(void)
+{
+    if (icon_index.map)
+        munmap((void *)icon_index.map, icon_index.map_size);
+    icon_index.map = nullptr;
+    icon_index.map_size = 0;
+    icon_index.records = nullptr;
+    icon_index.count = 0;
+    icon_index.blob = nullptr;
+}
+
+/*
+ * Lookups trust the records blindly, so check once that every key and path lies within the blob
+ * and that the records are sorted for the binary search.
+ */
+static bool records_valid(const struct index_record *records, uint32_t count, uint32_t blob_size)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        auto &r = records[i];
+        if ((uint64_t)r.key_offset + r.key_length > blob_size
+            || (uint64_t)r.path_offset + r.path_length > blob_size
+            || (i && records[i - 1].hash > r.hash))
+            return false;
+    }
+    return true;
+}
+
+static void map_index(void)
+{
+    int fd = open(icon_index.filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return;
+
+    struct stat st;
+    if (fstat(fd, &st) || (size_t)st.st_size < sizeof(struct index_header)) {
+        close(fd);
+        return;
+    }
+    void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return;
+
+    icon_index.map = static_cast<const unsigned char *>(map);
+    icon_index.map_size = st.st_size;
+
+    auto header = reinterpret_cast<const struct index_header *>(icon_index.map);
+    size_t records_size = (size_t)header->count * sizeof(struct index_record);
+    if (memcmp(header->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC))
+        || sizeof(*header) + records_size + header->blob_size != icon_index.map_size) {
+        warn("ignore corrupt icon index '{}'", icon_index.filename);
+        unmap_index();
+        return;
+    }
+    if (header->fingerprint != icon_index.fingerprint) {
+        if (conf.verbosity)
+            info("icon index is stale; rebuild");
+        unmap_index();
+        return;
+    }
+
+    auto records = reinterpret_cast<const struct index_record *>(icon_index.map + sizeof(*header));
+    if (!records_valid(records, header->count, header->blob_size)) {
+        warn("ignore corrupt icon index '{}'", icon_index.filename);
+        unmap_index();
+        return;
+    }
+    icon_index.records = records;
+    icon_index.count = header->count;
+    icon_index.blob = reinterpret_cast<const char *>(icon_index.records + icon_index.count);
+}
+
+static bool lookup_mapped(const std::string &key, uint64_t hash, std::string *iconpath)
+{
+    const struct index_record *end = icon_index.records + icon_index.count;
+    const struct index_record *it = std::lower_bound(
+            icon_index.records, end, hash,
+            [](const struct index_record &r, uint64_t h) { return r.hash < h; });
+    for (; it != end && it->hash == hash; ++it) {
+        if (it->key_length == key.size()
+            && !memcmp(icon_index.blob + it->key_offset, key.data(), key.size())) {
+            iconpath->assign(icon_index.blob + it->path_offset, it->path_length);
+            return true;
+        }
+    }
+    return false;
+}
+
+void iconIndexInit(const std::string &theme)
+{
+    icon_index.theme = theme;
+    std::string home = env_or("HOME", "");
+    icon_index.filename = env_or("XDG_CACHE_HOME", home + "/.cache") + "/tint/icon-index";
+    icon_index.fingerprint = compute_fingerprint();
+    map_index();
+}
+
+bool iconIndexLookup(const char *app_id, int size, float scale, std::string *iconpath)
+{
+    std::string key = make_key(app_id, size, scale);
+
+    auto it = icon_index.added.find(key);
+    if (it != icon_index.added.end()) {
+        *iconpath = it->second;
+        ++icon_index.stats.hits;
+        return true;
+    }
+    if (icon_index.records && lookup_mapped(key, fnv1a(key.data(), key.size()), iconpath)) {
+        ++icon_index.stats.hits;
+        return true;
+    }
+    ++icon_index.stats.misses;
+    return false;
+}
+
+void iconIndexRevalidate(void)
+{
+    // The mapped entries are merged into 'added' on save, so forget both
+    unmap_index();
+    icon_index.added.clear();
+    icon_index.fingerprint = compute_fingerprint();
+}
+
+void iconIndexInsert(const char *app_id, int size, float scale, const std::string &iconpath)
+{
+    icon_index.added[make_key(app_id, size, scale)] = iconpath;
+}
+
+static void save_index(void)
+{
+    // Merge the mapped entries with the ones resolved in this run
+    std::unordered_map<std::string, std::string> entries;
+    for (uint32_t i = 0; i < icon_index.count; i++) {
+        auto &r = icon_index.records[i];
+        entries.emplace(std::string(icon_index.blob + r.key_offset, r.key_length),
+                        std::string(icon_index.blob + r.path_offset, r.path_length));
+    }
+    for (auto &[key, path] : icon_index.added)
+        entries[key] = path;
+
+    std::vector<struct index_record> records;
+    std::string blob;
+    records.reserve(entries.size());
+    for (auto &[key, path] : entries) {
+        struct index_record r = {
+            .hash = fnv1a(key.data(), key.size()),
+            .key_offset = (uint32_t)blob.size(),
+            .key_length = (uint32_t)key.size(),
+            .path_offset = (uint32_t)(blob.size() + key.size()),
+            .path_length = (uint32_t)path.size(),
+        };
+        blob += key;
+        blob += path;
+        records.push_back(r);
+    }
+    std::ranges::sort(records, {}, &index_record::hash);
+
+    struct index_header header = {};
+    memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    header.fingerprint = icon_index.fingerprint;
+    header.count = records.size();
+    header.blob_size = blob.size();
+
+    std::error_code ec;
+    std::filesystem::path filename(icon_index.filename);
+    std::filesystem::create_directories(filename.parent_path(), ec);
+
+    // Write to a temporary file and rename so that readers never see a partial index
+    std::string tmp = icon_index.filename + ".tmp";
+    std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(records.data()),
+               records.size() * sizeof(struct index_record));
+    file.write(blob.data(), blob.size());
+    file.close();
+    if (!file || rename(tmp.c_str(), icon_index.filename.c_str())) {
+        warn("cannot write icon index '{}'", icon_index.filename);
+        unlink(tmp.c_str());
+    }
+}
+
+void iconIndexFinish(void)
+{
+    if (!icon_index.added.empty())
+        save_index();
+    unmap_index();
+    icon_index.added.clear();
+
+    if (conf.verbosity) {
+        uint64_t total = icon_index.stats.hits + icon_index.stats.misses;
+        info("icon index: {} hits, {} misses ({}% hit rate)", icon_index.stats.hits,
+             icon_index.stats.misses, total ? icon_index.stats.hits * 100 / total : 0);
+    }
+}
+
+struct icon_index_stats iconIndexStats(void)
+{
+    return icon_index.stats;
+}
@@ -0,0 +1,37 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <QImageReader>
+#include "icon-loader.h"
+#include "log.h"
+
+QImage loadIconImage(const std::string &path, int pixels)
+{
+    QImageReader reader(QString::fromStdString(path));
+    // .desktop files sometimes point at files with a wrong or no extension
+    reader.setDecideFormatFromContent(true);
+
+    QSize size = reader.size();
+    if (!size.isValid()) {
+        // SVGs without width/height, for example; render at the target size
+        size = QSize(pixels, pixels);
+    }
+    QSize target = size.scaled(pixels, pixels, Qt::KeepAspectRatio);
+
+    /*
+     * With ScaledSize support (SVG renders straight to the target, JPEG uses IDCT scaling) the
+     * full-size image is never materialized. Other formats are scaled by QImageReader right after
+     * decoding, which still avoids keeping the full-size image around.
+     */
+    if (target != size)
+        reader.setScaledSize(target);
+
+    QImage image = reader.read();
+    if (image.isNull()) {
+        info("cannot decode icon '{}': {}", path, reader.errorString().toStdString());
+        return image;
+    }
+
+    // Some handlers ignore the scaled size altogether
+    if (image.size() != target)
+        image = image.scaled(target, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    return image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+}
@@ -1,5 +1,6 @@
 // SPDX-License-Identifier: GPL-2.0-only
 #pragma once
+#include <string_view>
 #include <QString>
 #include <QColor>
 #include <QFont>
@@ -9,6 +10,11 @@ enum tint_task_state {
     TASK_MINIMIZED = (1 << 1),
 };
 
+enum panel_renderer {
+    RENDERER_SCENE,
+    RENDERER_RASTER,
+};
+
 struct padding {
     int horizontal;
     int vertical;
@@ -35,13 +41,16 @@ struct conf {
     std::string panel_items_right;
     int panel_background_id;
     int panel_height;
+    std::vector<std::string> panel_outputs;
 
     // Taskbar
     int taskbar_background_id;
     struct padding taskbar_padding;
+    int taskbar_grouping;
 
     // Task
     int task_maximum_size;
+    int task_minimum_size;
     QFont task_font;
     QColor task_font_color;
     int task_background_id;
@@ -49,18 +58,34 @@ struct conf {
 
     // Clock
     int clock_background_id;
+    std::string time1_format;
+    std::string time2_format;
     QFont time1_font;
+    QFont time2_font;
     QColor clock_font_color;
 
+    // Icons
+    int icon_cache_size;
+
     /* General (not set by config file) */
     QString output;
+    std::string record_toplevels;
+    enum panel_renderer renderer;
+    bool stats;
     double penWidth;
     int verbosity;
+    // Bumped whenever the configuration is (re)read, to invalidate anything derived from it
+    uint64_t generation;
 
 };
 
 extern conf conf;
 
 void confInit(QString filename);
+/* Applies the settings in @text on top of the current ones; @filename is used in diagnostics */
+void confParse(std::string_view text, std::string_view filename);
 void confSetOutput(QString output);
 void confSetVerbosity(int verbosity);
+void confSetRecordToplevels(QString filename);
+void confSetRenderer(QString renderer);
+void confSetStats(bool stats);
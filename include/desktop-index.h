@@ -0,0 +1,30 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#pragma once
+#include <sfdo-desktop.h>
+#include <string>
+
+/*
+ * Case-folded lookup tables over a loaded desktop database, used to match app_ids which are not
+ * exact desktop IDs. Built once per sfdo_desktop_db_load().
+ *
+ * Desktop files which change while tint is running are re-read individually and override the
+ * database entry with the same desktop ID, so the database itself is never reloaded.
+ */
+struct desktop_index;
+
+struct desktop_index *desktopIndexCreate(struct sfdo_desktop_db *db);
+void desktopIndexDestroy(struct desktop_index *index);
+
+/*
+ * Find the desktop entry for @app_id, first by desktop ID and then fuzzily. Returns false if no
+ * entry matches, otherwise sets @icon to its Icon key (which may be empty).
+ */
+bool desktopIndexLookup(struct desktop_index *index, const char *app_id, std::string *icon);
+
+/*
+ * Re-read the desktop file for @desktop_id from @path, or drop the entry if @path is empty.
+ * @precedence is the position of its data directory in $XDG_DATA_HOME:$XDG_DATA_DIRS, which
+ * decides between re-read entries matching the same app_id.
+ */
+void desktopIndexReload(struct desktop_index *index, const std::string &desktop_id,
+                        const std::string &path, int precedence);
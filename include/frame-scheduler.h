@@ -0,0 +1,31 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#pragma once
+#include <cstdint>
+#include <QRegion>
+#include <QWindow>
+
+/*
+ * Repaints paced by the compositor. Damage is collected until the window's next update request,
+ * which QtWayland only delivers once the previous frame callback is done, so any number of
+ * invalidations between two frames end up in one paint and one commit. While the compositor
+ * asks for no frames, for example with the output off, nothing is painted at all.
+ */
+class FrameScheduler
+{
+public:
+    FrameScheduler(QWindow *window);
+
+    void invalidate(const QRect &rect);
+
+    /* To be called on QEvent::UpdateRequest; returns the damage to paint, if any */
+    QRegion take(void);
+
+private:
+    QWindow *m_window;
+    QRegion m_damage;
+    bool m_pending;
+};
+
+/* Frames painted, and invalidations merged into an already scheduled frame, of all panels */
+uint64_t frameCommittedCount(void);
+uint64_t frameCoalescedCount(void);
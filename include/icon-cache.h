@@ -0,0 +1,52 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#pragma once
+#include <functional>
+#include <QPixmap>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "resources.h"
+
+/*
+ * Process-wide LRU cache of rasterized task icons keyed by (app_id, size, device pixel ratio).
+ *
+ * The returned QPixmap shares its data with the cached copy, so any number of windows of the
+ * same application hold a single decoded image. The byte budget is set by icon_cache_size.
+ *
+ * Icons which are not cached yet are resolved and decoded by a pool of worker threads and
+ * handed back to the GUI thread through the request callback.
+ */
+
+typedef uint64_t icon_ticket;
+typedef std::function<void(const QPixmap &)> icon_callback;
+typedef std::function<void(const std::unordered_set<std::string> &app_ids)> icon_invalidate_handler;
+typedef std::function<void(std::vector<struct icon_lookup> *lookups)> icon_lookups_handler;
+
+struct icon_cache_stats {
+    uint64_t hits;
+    uint64_t misses;
+    size_t bytes;
+};
+
+/*
+ * Call @callback with the icon for @app_id on the GUI thread. Returns 0 if the callback has
+ * already been called from the cache, or a ticket which can be used to cancel the request.
+ */
+icon_ticket iconCacheRequest(struct sfdo *sfdo, const std::string &app_id, int size, qreal dpr,
+                             icon_callback callback);
+void iconCacheCancel(icon_ticket ticket);
+
+/*
+ * Every (app_id, size, scale) which is cached or, according to the registered handlers, shown,
+ * for re-resolving after resources changed
+ */
+std::vector<struct icon_lookup> iconCacheLookups(void);
+/* Drop the icons of @app_ids and tell the registered handlers to request them again */
+void iconCacheInvalidate(const std::unordered_set<std::string> &app_ids);
+/* @lookups appends the icons @owner shows, which may have been evicted from the cache since */
+void iconCacheAddInvalidateHandler(void *owner, icon_lookups_handler lookups,
+                                   icon_invalidate_handler handler);
+void iconCacheRemoveInvalidateHandler(void *owner);
+void iconCacheSetLimit(size_t bytes);
+void iconCacheFinish(void);
+struct icon_cache_stats iconCacheStats(void);
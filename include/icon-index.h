@@ -0,0 +1,25 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#pragma once
+#include <cstdint>
+#include <string>
+
+/*
+ * Persistent app_id -> icon path index stored in $XDG_CACHE_HOME/tint/icon-index.
+ *
+ * Entries are keyed by (theme, size, scale, app_id). The whole file is thrown away when the
+ * mtime fingerprint of the XDG application and icon directories no longer matches, so a warm
+ * start can resolve icons without loading the desktop database or icon theme.
+ */
+
+struct icon_index_stats {
+    uint64_t hits;
+    uint64_t misses;
+};
+
+void iconIndexInit(const std::string &theme);
+void iconIndexFinish(void);
+bool iconIndexLookup(const char *app_id, int size, float scale, std::string *iconpath);
+void iconIndexInsert(const char *app_id, int size, float scale, const std::string &iconpath);
+/* Drop all entries after the directories were seen to change while running */
+void iconIndexRevalidate(void);
+struct icon_index_stats iconIndexStats(void);
@@ -0,0 +1,11 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#pragma once
+#include <QImage>
+#include <string>
+
+/*
+ * Decode the icon file at @path so that it fits a @pixels x @pixels square, keeping its aspect
+ * ratio. Scalable and multi-resolution formats are decoded straight at the target size instead
+ * of decoding the full image and shrinking it. Safe to call from any thread.
+ */
+QImage loadIconImage(const std::string &path, int pixels);
@@ -1,20 +1,108 @@
 // SPDX-License-Identifier: GPL-2.0-only
 #pragma once
+#include <unordered_map>
+#include <QGraphicsScene>
 #include <QMainWindow>
+#include <QRasterWindow>
+#include <QScreen>
 #include <QTimer>
+#include "frame-scheduler.h"
+#include "resource-watch.h"
 #include "resources.h"
+#include "tick-scheduler.h"
 
+class StatsServer;
+class Taskbar;
+class ToplevelSource;
+
+/* The layer-shell panel on one output */
 class Panel : public QMainWindow
 {
 public:
-    Panel(QWidget *parent = nullptr);
+    Panel(QScreen *screen, struct sfdo *sfdo, ToplevelSource *toplevels, QWidget *parent = nullptr);
     ~Panel();
 
 private:
     void updateGeometry();
     void updateGeometryDelayed();
 
-    QTimer m_timer;
+    TickSource m_geometryTick;
+    QScreen *m_screen;
     QWidget *m_centralWidget;
+    QRegion m_opaqueRegion;
+};
+
+/*
+ * The panel contents, shared by both renderers: background, plugins and the taskbar as scene
+ * items laid out for one output.
+ */
+class PanelScene : public QGraphicsScene
+{
+public:
+    PanelScene(QScreen *screen, struct sfdo *sfdo, ToplevelSource *toplevels);
+
+    QRegion opaqueRegion(void) const;
+    /* Called with the device pixel ratio of the window showing the scene whenever it changes */
+    void setDevicePixelRatio(qreal dpr);
+
+private:
+    void addPlugin(int type, bool left_aligned, int &offset);
+
+    Taskbar *m_taskbar;
+};
+
+/*
+ * Paint the items of @scene intersecting @region the way the raster renderer does: as a flat
+ * list, bottom to top, over a cleared background
+ */
+void panelPaintItems(QGraphicsScene *scene, QPainter *painter, const QRegion &region);
+
+/* The same panel drawn straight into a QRasterWindow; selected with --renderer raster */
+class RasterPanel : public QRasterWindow
+{
+public:
+    RasterPanel(QScreen *screen, struct sfdo *sfdo, ToplevelSource *toplevels);
+    ~RasterPanel();
+
+protected:
+    bool event(QEvent *event) override;
+    void paintEvent(QPaintEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseReleaseEvent(QMouseEvent *event) override;
+    void mouseDoubleClickEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void wheelEvent(QWheelEvent *event) override;
+
+private:
+    void damage(const QList<QRectF> &rects);
+    void sendMouseEvent(QEvent::Type type, QMouseEvent *event);
+
+    QScreen *m_screen;
+    PanelScene *m_scene;
+    QPointF m_lastMousePos;
+    bool m_painted;
+    FrameScheduler m_frames;
+    QRegion m_opaqueRegion;
+};
+
+/*
+ * Creates a panel on each selected output as outputs come and go. All panels share the desktop
+ * database, icon theme, icon cache and a single foreign-toplevel manager binding.
+ */
+class PanelManager : public QObject
+{
+public:
+    PanelManager();
+    ~PanelManager();
+
+private:
+    void addPanel(QScreen *screen);
+    void removePanel(QScreen *screen);
+
     struct sfdo m_sfdo;
+    ResourceWatcher *m_watcher;
+    ToplevelSource *m_toplevels;
+    StatsServer *m_stats;
+    // Panel or RasterPanel
+    std::unordered_map<QScreen *, QObject *> m_panels;
 };
@@ -3,9 +3,24 @@
 #include <QGraphicsItem>
 #include <QFont>
 #include <QString>
-#include <QTimer>
 #include "item-type.h"
+#include "render-style.h"
+#include "text-layout.h"
+#include "tick-scheduler.h"
 
+/* The smallest unit of time a clock format shows */
+enum clock_unit {
+    CLOCK_SECOND,
+    CLOCK_MINUTE,
+    CLOCK_HOUR,
+    CLOCK_DAY,
+};
+
+/*
+ * One or two lines of strftime() formatted time. The clock wakes up only when the text can
+ * change, at the next boundary of the smallest unit its formats show, through the tick
+ * scheduler, which also runs it after a suspend and when the wall clock is set.
+ */
 class ClockItem : public QObject, public QGraphicsItem
 {
     Q_OBJECT
@@ -24,8 +39,17 @@ public slots:
     void setTime();
 
 private:
+    void arm(void);
+    QRectF textRect(void);
+
     int m_width;
     int m_height;
-    QString m_text;
-    QTimer m_timer;
+    enum clock_unit m_unit;
+    QString m_time1;
+    QString m_time2;
+    TextLayout m_layout1;
+    TextLayout m_layout2;
+    qreal m_line1Height;
+    qreal m_textHeight;
+    TickSource m_tick;
 };
@@ -1,12 +1,22 @@
 // SPDX-License-Identifier: GPL-2.0-only
 #pragma once
 #include <QGraphicsView>
+#include <vector>
 #include "item-type.h"
+#include "render-style.h"
+#include "static-layer.h"
+
+class Task;
+class ToplevelSource;
+struct toplevel;
+struct toplevel_update;
 
 class Taskbar : public QGraphicsItem
 {
 public:
-    Taskbar(QGraphicsScene *scene, int height, int width, struct sfdo *sfdo);
+    /* Shows the windows on @output, or all windows if it is null */
+    Taskbar(QGraphicsScene *scene, int height, int width, struct sfdo *sfdo,
+            ToplevelSource *source, struct wl_output *output);
     ~Taskbar();
 
     enum { Type = UserType + PANEL_TYPE_TASKBAR };
@@ -17,22 +27,44 @@ public:
     void paint(QPainter *painter, const QStyleOptionGraphicsItem *option,
                QWidget *widget) Q_DECL_OVERRIDE;
 
-    void addTask(struct zwlr_foreign_toplevel_handle_v1 *);
+    void applyUpdates(const std::vector<struct toplevel_update> &updates);
     void updateTasks(void);
-    int taskWidth(void);
+    /* Device pixel ratio of the panel window, which icons are rasterized for */
+    void setIconScale(qreal scale);
+    qreal iconScale(void) const { return m_iconScale; }
+    int taskWidth(void) const { return m_taskWidth; }
+    StaticLayer &taskShape(void) { return m_taskShape; }
+
+protected:
+    QVariant itemChange(GraphicsItemChange change, const QVariant &value) override;
+    void wheelEvent(QGraphicsSceneWheelEvent *event) override;
 
 private:
-    void addForeignToplevelManager(struct wl_registry *, uint32_t name, uint32_t version);
-    void addSeat(struct wl_registry *registry, uint32_t name, uint32_t version);
-    struct wl_display *m_display;
-    struct zwlr_foreign_toplevel_manager_v1 *m_foreignToplevelManager;
-    struct wl_registry *m_registry;
+    bool isShown(const struct toplevel *toplevel) const;
+
+    ToplevelSource *m_toplevelSource;
+    struct wl_output *m_output;
     int m_width;
     int m_height;
     QGraphicsScene *m_scene;
     struct sfdo *m_sfdo;
+    qreal m_iconScale;
+
+    // All toplevels in the order they appeared
+    std::vector<struct toplevel *> m_toplevels;
+
+    // Items of the visible slots in the order they are shown, and their layout as of the last
+    // updateTasks()
+    std::vector<Task *> m_tasks;
+    int m_taskWidth;
+    int m_firstSlot;
+
+    // Pre-rendered backgrounds
+    StaticLayer m_layer;
+    StaticLayer m_taskShape;
 
 public:
     // Getters
     struct sfdo *sfdo() const { return m_sfdo; }
+    ToplevelSource *toplevelSource() const { return m_toplevelSource; }
 };
@@ -0,0 +1,42 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#pragma once
+#include <utility>
+#include <vector>
+#include <QBrush>
+#include <QPainter>
+#include <QPainterPath>
+#include <QPen>
+
+/*
+ * Backgrounds compiled into what paint() needs: a ready pen and brush, the corner radius, and
+ * rounded paths cached per size. The table is rebuilt whenever the config is read, so items look
+ * their style up by background id when painting instead of keeping references into it.
+ */
+struct render_style {
+    QPen pen;
+    QBrush brush;
+    qreal radius;
+    // Fully opaque, so rectangles can be drawn pixel-snapped without antialiasing
+    bool opaque;
+    // Rounded paths at the origin, by size; items come in very few sizes
+    mutable std::vector<std::pair<QSizeF, QPainterPath>> paths;
+};
+
+void renderStylesInit(void);
+const struct render_style &renderStyle(int background_id);
+
+/*
+ * Draw @rect with @style, as QPainter::drawRect() would with a pen centred on its edges. Corners
+ * are never rounded.
+ */
+void renderStyleDrawRect(QPainter *painter, const QRectF &rect, const struct render_style &style);
+
+/*
+ * The part of @bounds covered with fully opaque pixels when an item fills it with
+ * renderStyleDrawRect(), pen centred on the inset edges; empty if none of it is
+ */
+QRect renderStyleOpaqueRect(const struct render_style &style, const QRect &bounds);
+
+/* Like renderStyleDrawRect(), with rounded corners and optionally another style's border */
+void renderStyleDrawShape(QPainter *painter, const QRectF &rect, const struct render_style &style,
+                          const QPen *pen = nullptr);
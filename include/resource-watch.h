@@ -0,0 +1,51 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <QSocketNotifier>
+#include <QThreadPool>
+#include <QTimer>
+#include "resources.h"
+
+/*
+ * Watches the XDG applications directories and the active icon theme with inotify. Changes are
+ * debounced, applied to the loaded desktop database and icon theme on a worker thread, and only
+ * the icons of affected app_ids are decoded again.
+ */
+class ResourceWatcher
+{
+public:
+    ResourceWatcher(struct sfdo *sfdo);
+    ~ResourceWatcher();
+
+private:
+    enum watch_kind {
+        WATCH_APPLICATIONS,
+        WATCH_ICONS,
+    };
+
+    struct watch {
+        enum watch_kind kind;
+        std::string path;
+        // Path relative to the applications directory, used to build desktop IDs
+        std::string relpath;
+    };
+
+    void addWatches(void);
+    void addWatch(enum watch_kind kind, const std::string &path, const std::string &relpath);
+    void addWatchRecursive(enum watch_kind kind, const std::string &path,
+                           const std::string &relpath);
+    void readEvents(void);
+    void addDesktopFile(const struct watch &watch, const std::string &name);
+    void rescan(void);
+    void apply(void);
+
+    struct sfdo *m_sfdo;
+    int m_fd;
+    QSocketNotifier *m_notifier;
+    QTimer m_debounce;
+    // Reloads run one at a time and must finish before the sfdo state goes away
+    QThreadPool m_pool;
+    std::unordered_map<int, struct watch> m_watches;
+    struct resource_changes m_changes;
+};
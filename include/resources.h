@@ -3,14 +3,58 @@
 #include <sfdo-desktop.h>
 #include <sfdo-icon.h>
 #include <sfdo-basedir.h>
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 struct sfdo {
+    /*
+     * The desktop database and icon theme are loaded in the background once the panel is up (or
+     * on the first icon index miss), so neither blocks the first frame. Either may be null
+     * afterwards if loading failed.
+     */
+    std::once_flag load_started;
+    std::once_flag load_finished;
+    std::atomic<bool> loading;
+    std::future<void> desktop_db_loading;
+    std::future<void> icon_theme_loading;
+    std::string theme;
+    struct sfdo_basedir_ctx *basedir_ctx;
     struct sfdo_desktop_ctx *desktop_ctx;
     struct sfdo_icon_ctx *icon_ctx;
     struct sfdo_desktop_db *desktop_db;
+    struct desktop_index *desktop_index;
     struct sfdo_icon_theme *icon_theme;
 };
 
+/* Files which changed on disk since the desktop database and icon theme were loaded */
+struct resource_changes {
+    // Desktop ID and path relative to the applications directory of each changed desktop file
+    std::vector<std::pair<std::string, std::string>> desktop_files;
+    std::unordered_set<std::string> files;
+    bool icon_theme;
+};
+
+struct icon_lookup {
+    std::string app_id;
+    int size;
+    float scale;
+};
+
 void desktopEntryInit(struct sfdo *sfdo);
+void desktopEntryLoadAsync(struct sfdo *sfdo);
 void desktopEntryFinish(struct sfdo *sfdo);
 std::string load_icon_from_app_id(struct sfdo *sfdo, const char *app_id, int size, float scale);
+
+/*
+ * Apply @changes to the loaded state and resolve @lookups again. Returns the app_ids whose icon
+ * changed. This blocks while the icon theme is reloaded, so call it from a worker thread.
+ */
+std::unordered_set<std::string> desktopEntryReload(struct sfdo *sfdo,
+                                                  const struct resource_changes &changes,
+                                                  const std::vector<struct icon_lookup> &lookups);
+std::vector<std::string> xdgDataDirs(void);
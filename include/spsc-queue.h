@@ -0,0 +1,60 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#pragma once
+#include <atomic>
+#include <optional>
+#include <utility>
+
+/*
+ * Unbounded lock-free queue for exactly one producer and one consumer thread. The consumer owns
+ * a dummy head node; push() links a new tail and pop() advances the head, so the two threads
+ * never touch the same node except through the atomic 'next' pointer.
+ */
+template <typename T>
+class SpscQueue
+{
+public:
+    SpscQueue() { m_head = m_tail = new node; }
+
+    ~SpscQueue()
+    {
+        while (m_head) {
+            node *next = m_head->next.load(std::memory_order_relaxed);
+            delete m_head;
+            m_head = next;
+        }
+    }
+
+    SpscQueue(const SpscQueue &) = delete;
+    SpscQueue &operator=(const SpscQueue &) = delete;
+
+    /* Producer thread only */
+    void push(T value)
+    {
+        node *n = new node;
+        n->value = std::move(value);
+        m_tail->next.store(n, std::memory_order_release);
+        m_tail = n;
+    }
+
+    /* Consumer thread only */
+    std::optional<T> pop(void)
+    {
+        node *next = m_head->next.load(std::memory_order_acquire);
+        if (!next)
+            return std::nullopt;
+        std::optional<T> value = std::move(next->value);
+        next->value.reset();
+        delete m_head;
+        m_head = next;
+        return value;
+    }
+
+private:
+    struct node {
+        std::optional<T> value;
+        std::atomic<node *> next{ nullptr };
+    };
+
+    node *m_head;
+    node *m_tail;
+};
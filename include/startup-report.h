@@ -0,0 +1,22 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#pragma once
+#include <chrono>
+
+/*
+ * Wall time of the startup phases, printed to stderr as each phase ends when tint is started
+ * with --startup-report. Phases may run concurrently on different threads.
+ */
+class StartupPhase
+{
+public:
+    StartupPhase(const char *name);
+    ~StartupPhase();
+    void end(void);
+
+private:
+    const char *m_name;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+void startupReportEnable(void);
+void startupReportMark(const char *name);
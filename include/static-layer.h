@@ -0,0 +1,35 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#pragma once
+#include <functional>
+#include <QPainter>
+#include <QPixmap>
+#include <QRectF>
+
+/*
+ * Static panel content (backgrounds, inactive task shapes) rasterized once with antialiasing into
+ * a device-pixel pixmap, then copied on every repaint. It is rendered again only when its size,
+ * the device pixel ratio or the configuration changes, so clock ticks and hover changes no longer
+ * re-rasterize rounded paths.
+ */
+class StaticLayer
+{
+public:
+    typedef std::function<void(QPainter *painter)> render_fn;
+
+    StaticLayer();
+
+    /*
+     * Draw the layer covering @rect, in the painter's current coordinates. @render draws the
+     * content in those same coordinates and is only called when the cached copy is stale.
+     */
+    void draw(QPainter *painter, const QRectF &rect, const render_fn &render);
+
+private:
+    QPixmap m_pixmap;
+    QRectF m_rect;
+    qreal m_dpr;
+    uint64_t m_generation;
+};
+
+/* Number of times any StaticLayer had to be rendered, for --debug frame statistics */
+uint64_t staticLayerCount(void);
@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <QObject>
+#include <QSocketNotifier>
+
+/*
+ * Runtime statistics for finding out what keeps an idle panel busy. With --stats, a snapshot is
+ * served as one line of JSON on a Unix socket in $XDG_RUNTIME_DIR for every request written to
+ * it. Paint times and Wayland events are only collected while a client is connected; until then
+ * each hook below is a relaxed load and a branch. Timer wake-ups are always counted by the tick
+ * scheduler.
+ */
+
+enum stats_listener {
+    STATS_LISTENER_REGISTRY,
+    STATS_LISTENER_TOPLEVEL_MANAGER,
+    STATS_LISTENER_TOPLEVEL,
+    STATS_LISTENER_COUNT,
+};
+
+extern std::atomic<bool> stats_collecting;
+
+void statsAddWaylandEvent(enum stats_listener listener);
+void statsAddPaint(int type, std::chrono::steady_clock::duration time);
+
+/* Any thread */
+static inline void statsCountWaylandEvent(enum stats_listener listener)
+{
+    if (stats_collecting.load(std::memory_order_relaxed))
+        statsAddWaylandEvent(listener);
+}
+
+/* Times the paint() of an item of type PANEL_TYPE_* for the paint time histograms */
+class StatsPaintTimer
+{
+public:
+    StatsPaintTimer(int type) : m_type{ type }
+    {
+        m_active = stats_collecting.load(std::memory_order_relaxed);
+        if (m_active)
+            m_start = std::chrono::steady_clock::now();
+    }
+    ~StatsPaintTimer()
+    {
+        if (m_active)
+            statsAddPaint(m_type, std::chrono::steady_clock::now() - m_start);
+    }
+
+private:
+    int m_type;
+    bool m_active;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+class StatsServer : public QObject
+{
+public:
+    StatsServer();
+    ~StatsServer();
+
+private:
+    void accept(void);
+    void read(int fd);
+    void drop(int fd);
+
+    int m_fd;
+    std::string m_path;
+    std::unordered_map<int, QSocketNotifier *> m_clients;
+};
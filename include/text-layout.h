@@ -0,0 +1,37 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#pragma once
+#include <cstdint>
+#include <QFont>
+#include <QStaticText>
+#include <QString>
+
+/*
+ * A single line of elided text, shaped once and kept as a QStaticText until the text, the font,
+ * the available width or the elide mode changes. Each item owns one per label so repaints
+ * (hover, clock ticks that do not change the text) do no text shaping at all.
+ */
+class TextLayout
+{
+public:
+    TextLayout();
+
+    const QStaticText &layout(const QString &text, const QFont &font, qreal width,
+                              Qt::TextElideMode mode = Qt::ElideRight);
+
+private:
+    QString m_text;
+    QFont m_font;
+    qreal m_width;
+    Qt::TextElideMode m_mode;
+    bool m_valid;
+    QStaticText m_staticText;
+};
+
+struct text_layout_stats {
+    uint64_t hits;
+    uint64_t misses;
+};
+
+/* Number of times any TextLayout had to shape its text, for --debug frame statistics */
+uint64_t textLayoutCount(void);
+struct text_layout_stats textLayoutStats(void);
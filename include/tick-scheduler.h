@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#pragma once
+#include <chrono>
+#include <functional>
+#include <map>
+#include <string>
+
+/*
+ * One timer for all periodic panel work. Each source asks to run at a deadline and says how
+ * much later it may run. The scheduler sleeps until the earliest time by which some source must
+ * run, then runs every source whose deadline has passed, so sources with overlapping windows
+ * share a single wake-up.
+ *
+ * Deadlines are wall-clock times on an absolute CLOCK_REALTIME timerfd: they are met after a
+ * suspend, and every scheduled source runs when the wall clock is set so that it can
+ * reschedule. Non-essential sources are held back while no panel is visible and run as soon as
+ * one is again.
+ *
+ * GUI thread only.
+ */
+class TickSource
+{
+public:
+    typedef std::function<void(void)> callback;
+
+    /* @name groups sources in the wake-up counters */
+    TickSource(const char *name, std::chrono::milliseconds tolerance, bool essential,
+               callback callback);
+    ~TickSource();
+
+    void schedule(std::chrono::system_clock::time_point deadline);
+    void scheduleIn(std::chrono::milliseconds delay)
+    {
+        schedule(std::chrono::system_clock::now() + delay);
+    }
+    void cancel(void);
+
+private:
+    friend struct tick_scheduler;
+
+    std::chrono::milliseconds m_tolerance;
+    bool m_essential;
+    callback m_callback;
+    bool m_scheduled;
+    std::chrono::system_clock::time_point m_deadline;
+    uint64_t *m_wakeups;
+};
+
+/* Visibility of each panel; @owner is any unique pointer */
+void tickSetVisible(void *owner, bool visible);
+void tickForgetVisible(void *owner);
+
+/* Callbacks run per source name, and timer wake-ups in total */
+const std::map<std::string, uint64_t> &tickSourceWakeups(void);
+uint64_t tickWakeups(void);
@@ -0,0 +1,56 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "toplevel-source.h"
+
+/*
+ * Recorded foreign-toplevel event streams, for reproducing taskbar behaviour without the
+ * compositor and workload it was seen with.
+ *
+ * A recording is the magic "TINTREC1" followed by one record per batch of updates: the time
+ * since the previous batch in microseconds, then each update with its id, flags and the
+ * properties that changed. Integers are LEB128 varints. Outputs are stored as small indices in
+ * order of first appearance, since their proxies mean nothing in another process.
+ */
+
+struct toplevel_batch {
+    // Time since the start of the recording
+    std::chrono::microseconds time;
+    std::vector<struct toplevel_update> updates;
+};
+
+class ToplevelRecorder
+{
+public:
+    ToplevelRecorder(const std::string &path);
+
+    void write(const std::vector<struct toplevel_update> &updates);
+
+private:
+    std::ofstream m_file;
+    std::chrono::steady_clock::time_point m_last;
+    std::unordered_map<struct wl_output *, uint32_t> m_outputs;
+};
+
+/* Feeds recorded batches to the taskbar; requests have nowhere to go and are only counted */
+class ToplevelReplay : public ToplevelSource
+{
+public:
+    void deliver(const std::vector<struct toplevel_update> &updates) { dispatch(updates); }
+    void request(uint32_t id, enum toplevel_action action, struct wl_seat *seat) override
+    {
+        m_requests++;
+    }
+    uint64_t requests(void) const { return m_requests; }
+
+private:
+    uint64_t m_requests = 0;
+};
+
+/* Returns false if @path cannot be read or is not a valid recording */
+bool toplevelRecordLoad(const std::string &path, std::vector<struct toplevel_batch> *batches);
@@ -0,0 +1,62 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+/*
+ * Toplevel properties received since the last 'done' event. The protocol defines 'done' as the
+ * point where a set of changes becomes atomic, so nothing is applied before it arrives.
+ */
+struct task_pending {
+    std::optional<std::string> title;
+    std::optional<std::string> app_id;
+    std::optional<uint32_t> state;
+    std::vector<struct wl_output *> outputs_entered;
+    std::vector<struct wl_output *> outputs_left;
+};
+
+/* One atomic change of a toplevel, identified by an id which is never reused */
+struct toplevel_update {
+    uint32_t id;
+    bool added;
+    bool closed;
+    struct task_pending pending;
+};
+
+enum toplevel_action {
+    TOPLEVEL_ACTIVATE,
+    TOPLEVEL_SET_MINIMIZED,
+    TOPLEVEL_UNSET_MINIMIZED,
+};
+
+/*
+ * Where taskbars get their toplevels from: the compositor through ToplevelThread, or a recorded
+ * event stream through ToplevelReplay. Updates are handed to every registered handler (one per
+ * panel) on the GUI thread, one batch per protocol dispatch.
+ *
+ * The current state of all toplevels is kept as well, so that a handler added later (the panel
+ * of an output connected after startup) first gets every existing toplevel as added.
+ */
+class ToplevelSource
+{
+public:
+    using handler = std::function<void(const std::vector<struct toplevel_update> &)>;
+
+    virtual ~ToplevelSource() = default;
+
+    void addHandler(void *owner, handler on_updates);
+    void removeHandler(void *owner) { m_handlers.erase(owner); }
+    virtual void request(uint32_t id, enum toplevel_action action, struct wl_seat *seat) = 0;
+
+protected:
+    void dispatch(const std::vector<struct toplevel_update> &updates);
+
+private:
+    std::map<void *, handler> m_handlers;
+    // Every open toplevel as one update adding it with all its properties, by id
+    std::map<uint32_t, struct toplevel_update> m_current;
+};
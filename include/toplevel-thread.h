@@ -0,0 +1,78 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <QObject>
+#include "spsc-queue.h"
+#include "toplevel-record.h"
+#include "toplevel-source.h"
+
+/*
+ * Binds the foreign-toplevel manager on a private wl_event_queue and dispatches it on a
+ * dedicated thread, so that protocol processing is never held up by painting or icon decoding.
+ *
+ * The thread keeps its own table of toplevel handles. Everything that happened during one
+ * dispatch is published to the GUI thread as one batch of updates; actions go the other way by
+ * id, since only the protocol thread may touch (and destroy) the handles.
+ */
+class ToplevelThread : public ToplevelSource
+{
+public:
+    /* If @record_path is not empty, the event stream is also written there */
+    ToplevelThread(struct wl_display *display, const std::string &record_path);
+    ~ToplevelThread();
+
+    void request(uint32_t id, enum toplevel_action action, struct wl_seat *seat) override;
+
+private:
+    struct entry {
+        ToplevelThread *thread;
+        uint32_t id;
+        struct zwlr_foreign_toplevel_handle_v1 *handle;
+        bool added;
+        struct task_pending pending;
+    };
+
+    struct action_request {
+        uint32_t id;
+        enum toplevel_action action;
+        struct wl_seat *seat;
+    };
+
+    static const struct zwlr_foreign_toplevel_handle_v1_listener handle_listener;
+
+    void run(void);
+    void bindManager(struct wl_registry *registry, uint32_t name, uint32_t version);
+    void addToplevel(struct zwlr_foreign_toplevel_handle_v1 *handle);
+    void commit(struct entry *entry);
+    void remove(struct entry *entry);
+    void handleRequests(void);
+    void publish(void);
+    void deliver(void);
+
+    struct wl_display *m_display;
+    struct wl_event_queue *m_queue;
+    struct wl_display *m_wrapper;
+    struct wl_registry *m_registry;
+    struct zwlr_foreign_toplevel_manager_v1 *m_manager;
+    ToplevelRecorder *m_recorder;
+
+    // Protocol thread state
+    uint32_t m_nextId;
+    std::unordered_map<uint32_t, struct entry *> m_entries;
+    std::vector<struct toplevel_update> m_batch;
+
+    // Thread hand-over
+    SpscQueue<std::vector<struct toplevel_update>> m_updates;
+    SpscQueue<struct action_request> m_requests;
+    std::atomic<bool> m_notified;
+    std::atomic<bool> m_stop;
+    int m_wakeup;
+    // Queued deliveries are dropped together with this object
+    QObject m_receiver;
+    std::thread m_thread;
+};
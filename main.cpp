@@ -5,6 +5,7 @@
 #include "log.h"
 #include "conf.h"
 #include "panel.h"
+#include "startup-report.h"
 
 void handleQuitSignals(const std::vector<int> &quitSignals)
 {
@@ -42,7 +43,28 @@ int main(int argc, char **argv)
     config.setValueName("filename");
     parser.addOption(config);
 
+    QCommandLineOption startupReport(QStringList() << "startup-report");
+    startupReport.setDescription("Print the wall time of each startup phase");
+    parser.addOption(startupReport);
+
+    QCommandLineOption recordToplevels(QStringList() << "record-toplevels");
+    recordToplevels.setDescription("Record foreign-toplevel events to a file for replay");
+    recordToplevels.setValueName("filename");
+    parser.addOption(recordToplevels);
+
+    QCommandLineOption renderer(QStringList() << "renderer");
+    renderer.setDescription("Renderer to use: 'scene' (default) or 'raster'");
+    renderer.setValueName("renderer");
+    parser.addOption(renderer);
+
+    QCommandLineOption stats(QStringList() << "stats");
+    stats.setDescription("Serve runtime statistics on a socket in $XDG_RUNTIME_DIR");
+    parser.addOption(stats);
+
     parser.process(app);
+    if (parser.isSet(startupReport)) {
+        startupReportEnable();
+    }
 
     QString filename = parser.value(config);
     if (filename.isEmpty()) {
@@ -50,13 +72,17 @@ int main(int argc, char **argv)
     }
 
     info("read config file '{}'", filename.toStdString());
+    StartupPhase configPhase("config");
     confInit(filename);
     confSetOutput(parser.value(output));
+    confSetRecordToplevels(parser.value(recordToplevels));
+    confSetRenderer(parser.value(renderer));
     if (parser.isSet(debug)) {
         confSetVerbosity(1);
     }
+    confSetStats(parser.isSet(stats));
+    configPhase.end();
 
-    Panel panel;
-    panel.show();
+    PanelManager panels;
     return app.exec();
 }
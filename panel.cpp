@@ -1,4 +1,6 @@
 // SPDX-License-Identifier: GPL-2.0-only
+#include <algorithm>
+#include <chrono>
 #include <QApplication>
 #include <QCoreApplication>
 #include <QDebug>
@@ -6,16 +8,31 @@
 #include <LayerShellQt/shell.h>
 #include <LayerShellQt/window.h>
 #include <QtWaylandClient/private/qwayland-xdg-shell.h>
+#include <qpa/qplatformnativeinterface.h>
+#include <wayland-client.h>
 #include <QGraphicsView>
 #include <QGraphicsItem>
+#include <QGraphicsSceneMouseEvent>
+#include <QGraphicsSceneWheelEvent>
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
+#include <QSurfaceFormat>
 #include <QTimer>
 #include <QStackedLayout>
 #include "conf.h"
+#include "frame-scheduler.h"
+#include "icon-cache.h"
 #include "item-type.h"
 #include "log.h"
 #include "panel.h"
 #include "plugin-clock.h"
 #include "plugin-taskbar.h"
+#include "render-style.h"
+#include "startup-report.h"
+#include "stats.h"
+#include "static-layer.h"
+#include "text-layout.h"
+#include "toplevel-thread.h"
 
 class BackgroundItem : public QGraphicsItem
 {
@@ -32,6 +49,7 @@ public:
 private:
     int m_width;
     int m_height;
+    StaticLayer m_layer;
 };
 
 BackgroundItem::BackgroundItem(int width, int height)
@@ -55,45 +73,22 @@ QRectF BackgroundItem::fullDrawingRect()
 
 void BackgroundItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *, QWidget *)
 {
-    QPen pen(QColor(conf.backgrounds.at(conf.panel_background_id)->border_color));
-    pen.setStyle(Qt::SolidLine);
-    pen.setWidth(conf.penWidth);
-    painter->setPen(pen);
-    painter->setBrush(conf.backgrounds.at(conf.panel_background_id)->background_color);
-    painter->drawRect(fullDrawingRect());
+    StatsPaintTimer timer(PANEL_TYPE_BACKGROUND);
+    m_layer.draw(painter, boundingRect(), [this](QPainter *painter) {
+        renderStyleDrawRect(painter, fullDrawingRect(), renderStyle(conf.panel_background_id));
+    });
 }
 
-class View : public QGraphicsView
+PanelScene::PanelScene(QScreen *screen, struct sfdo *sfdo, ToplevelSource *toplevels)
 {
-public:
-    View(QRect screenGeometry, struct sfdo *sfdo, QWidget *parent = 0);
-    ~View();
-    void addPlugin(int type, bool left_aligned, int &offset);
-
-private:
-    QWidget *m_parent;
-    QGraphicsScene m_scene;
-};
-
-View::View(QRect screenGeometry, struct sfdo *sfdo, QWidget *parent) : QGraphicsView(parent)
-{
-    m_parent = parent;
-    setScene(&m_scene);
-
-    int width = screenGeometry.width();
+    int width = screen->geometry().width();
     int height = conf.panel_height;
 
-    m_scene.setSceneRect(0, 0, width, height);
-    m_scene.setItemIndexMethod(QGraphicsScene::NoIndex);
-
-    setRenderHint(QPainter::Antialiasing);
-    setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
-    setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
-    setStyleSheet("background-color: transparent;");
-    setFrameStyle(QFrame::NoFrame);
+    setSceneRect(0, 0, width, height);
+    setItemIndexMethod(QGraphicsScene::NoIndex);
 
     BackgroundItem *p = new BackgroundItem(width, height);
-    m_scene.addItem(p);
+    addItem(p);
     p->setPos(0, 0);
 
     info("load plugins");
@@ -113,30 +108,49 @@ View::View(QRect screenGeometry, struct sfdo *sfdo, QWidget *parent) : QGraphics
     int taskbarWidth = offset_from_right - offset_from_left;
     if (taskbarWidth < 200)
         die("not enough space for taskbar; remove some plugins");
-    Taskbar *taskbar = new Taskbar(&m_scene, conf.panel_height, taskbarWidth, sfdo);
-    m_scene.addItem(taskbar);
-    taskbar->setPos(offset_from_left, 0);
+    auto waylandScreen = screen->nativeInterface<QNativeInterface::QWaylandScreen>();
+    struct wl_output *output = waylandScreen ? waylandScreen->output() : nullptr;
+    m_taskbar = new Taskbar(this, conf.panel_height, taskbarWidth, sfdo, toplevels, output);
+    m_taskbar->setIconScale(screen->devicePixelRatio());
+    addItem(m_taskbar);
+    m_taskbar->setPos(offset_from_left, 0);
+}
 
-    // Set the icon positions
-    //    int i = 0;
-    //    foreach (QGraphicsItem *item, items()) {
-    //        if (Item *p = qgraphicsitem_cast<Item *>(item)) {
-    //            int y = 0;
-    //            int x = i * 90;
-    //            p->setPos(x, y);
-    //            i++;
-    //        }
-    //    }
+void PanelScene::setDevicePixelRatio(qreal dpr)
+{
+    m_taskbar->setIconScale(dpr);
 }
 
-View::~View() { }
+/* What the backgrounds of the items cover with opaque pixels; tasks come and go, so not those */
+QRegion PanelScene::opaqueRegion(void) const
+{
+    QRegion region;
+    for (QGraphicsItem *item : items()) {
+        int id;
+        switch (item->type()) {
+        case BackgroundItem::Type:
+            id = conf.panel_background_id;
+            break;
+        case Taskbar::Type:
+            id = conf.taskbar_background_id;
+            break;
+        case ClockItem::Type:
+            id = conf.clock_background_id;
+            break;
+        default:
+            continue;
+        }
+        region += renderStyleOpaqueRect(renderStyle(id), item->sceneBoundingRect().toRect());
+    }
+    return region;
+}
 
-void View::addPlugin(int type, bool left_aligned, int &offset)
+void PanelScene::addPlugin(int type, bool left_aligned, int &offset)
 {
     switch (type) {
     case 'C': {
         ClockItem *clockItem = new ClockItem(this, conf.panel_height);
-        m_scene.addItem(clockItem);
+        addItem(clockItem);
         if (!left_aligned)
             offset -= clockItem->boundingRect().width();
         clockItem->setPos(offset, 0);
@@ -149,15 +163,139 @@ void View::addPlugin(int type, bool left_aligned, int &offset)
     }
 }
 
-Panel::Panel(QWidget *parent) : QMainWindow(parent)
+/* Log per-frame work and mark the first frame for the startup report */
+static void frame_painted(bool *painted, uint64_t layouts, uint64_t layers)
 {
-    info("load sfdo resources");
-    desktopEntryInit(&m_sfdo);
+    if (conf.verbosity)
+        info("frame: {} text layouts, {} static layers; {} frames, {} updates coalesced",
+             textLayoutCount() - layouts, staticLayerCount() - layers, frameCommittedCount(),
+             frameCoalescedCount());
+    if (!*painted) {
+        *painted = true;
+        startupReportMark("first frame");
+    }
+}
 
-    info("init layer-shell surface");
-    LayerShellQt::Shell::useLayerShell();
-    this->winId();
-    QWindow *window = this->windowHandle();
+/*
+ * Events after which the window may have a different device pixel ratio. The scale is only known
+ * for sure once the window is exposed on its output.
+ */
+static bool scale_may_change(QEvent *event)
+{
+    switch (event->type()) {
+    case QEvent::Expose:
+    case QEvent::ScreenChangeInternal:
+#if QT_VERSION >= QT_VERSION_CHECK(6, 6, 0)
+    case QEvent::DevicePixelRatioChange:
+#endif
+        return true;
+    default:
+        return false;
+    }
+}
+
+class View : public QGraphicsView
+{
+public:
+    View(QScreen *screen, struct sfdo *sfdo, ToplevelSource *toplevels, QWidget *parent = 0);
+    ~View();
+
+    QRegion opaqueRegion(void) const { return m_scene.opaqueRegion(); }
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+    void paintEvent(QPaintEvent *event) override;
+
+private:
+    void damage(const QList<QRectF> &rects);
+
+    QWidget *m_parent;
+    bool m_painted;
+    PanelScene m_scene;
+    FrameScheduler m_frames;
+};
+
+/*
+ * The view does not update itself on scene changes. Damage goes through the frame scheduler
+ * and is repainted when the panel window gets its next update request.
+ */
+View::View(QScreen *screen, struct sfdo *sfdo, ToplevelSource *toplevels, QWidget *parent)
+    : QGraphicsView(parent), m_scene(screen, sfdo, toplevels),
+      m_frames(parent->window()->windowHandle())
+{
+    m_parent = parent;
+    m_painted = false;
+    setScene(&m_scene);
+    setViewportUpdateMode(QGraphicsView::NoViewportUpdate);
+    connect(&m_scene, &QGraphicsScene::changed, this, &View::damage);
+    parent->window()->windowHandle()->installEventFilter(this);
+
+    setRenderHint(QPainter::Antialiasing);
+    setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    setStyleSheet("background-color: transparent;");
+    setFrameStyle(QFrame::NoFrame);
+}
+
+View::~View()
+{
+    tickForgetVisible(this);
+}
+
+void View::damage(const QList<QRectF> &rects)
+{
+    // Antialiased edges reach half a pixel beyond the bounding rectangles
+    for (const QRectF &rect : rects)
+        m_frames.invalidate(mapFromScene(rect).boundingRect().adjusted(-1, -1, 1, 1));
+}
+
+bool View::eventFilter(QObject *watched, QEvent *event)
+{
+    if (event->type() == QEvent::UpdateRequest) {
+        QRegion damage = m_frames.take();
+        if (!damage.isEmpty())
+            viewport()->repaint(damage);
+    } else if (event->type() == QEvent::Expose) {
+        tickSetVisible(this, static_cast<QWindow *>(watched)->isExposed());
+    }
+    if (scale_may_change(event))
+        m_scene.setDevicePixelRatio(static_cast<QWindow *>(watched)->devicePixelRatio());
+    return QGraphicsView::eventFilter(watched, event);
+}
+
+void View::paintEvent(QPaintEvent *event)
+{
+    uint64_t layouts = textLayoutCount();
+    uint64_t layers = staticLayerCount();
+    QGraphicsView::paintEvent(event);
+    frame_painted(&m_painted, layouts, layers);
+}
+
+/*
+ * Tell the compositor which part of the panel needs no blending, so that it can also skip what
+ * is underneath. Qt has no API for this. The region applies from the next commit and has to be
+ * set again whenever the surface is recreated, i.e. after every show().
+ */
+static void set_opaque_region(QWindow *window, const QRegion &opaque)
+{
+    QPlatformNativeInterface *native = QGuiApplication::platformNativeInterface();
+    auto surface = static_cast<struct wl_surface *>(
+            native->nativeResourceForWindow("surface", window));
+    auto compositor = static_cast<struct wl_compositor *>(
+            native->nativeResourceForIntegration("compositor"));
+    if (!surface || !compositor)
+        return;
+    struct wl_region *region = wl_compositor_create_region(compositor);
+    for (const QRect &rect : opaque)
+        wl_region_add(region, rect.x(), rect.y(), rect.width(), rect.height());
+    wl_surface_set_opaque_region(surface, region);
+    wl_region_destroy(region);
+}
+
+/* Layer-shell role shared by both renderers; must be set up before the window is shown */
+static LayerShellQt::Window *setup_layer_shell(QWindow *window, QScreen *screen)
+{
+    window->setScreen(screen);
     LayerShellQt::Window *layerShell = LayerShellQt::Window::get(window);
 
     // Panel margins
@@ -177,23 +315,32 @@ Panel::Panel(QWidget *parent) : QMainWindow(parent)
     const auto interactivity = QMetaEnum::fromType<LayerShellQt::Window::KeyboardInteractivity>();
     layerShell->setKeyboardInteractivity(LayerShellQt::Window::KeyboardInteractivity(
             interactivity.keyToValue("KeyboardInteractivityNone")));
+    layerShell->setExclusiveZone(conf.panel_height);
+    return layerShell;
+}
 
-    setAttribute(Qt::WA_TranslucentBackground);
+Panel::Panel(QScreen *screen, struct sfdo *sfdo, ToplevelSource *toplevels, QWidget *parent)
+    : QMainWindow(parent),
+      m_geometryTick("geometry", std::chrono::milliseconds(100), /* essential */ true,
+                     [this]() { updateGeometry(); }),
+      m_screen{ screen }
+{
+    StartupPhase surfacePhase("layer-shell surface");
+    info("init layer-shell surface on output '{}'", screen->name().toStdString());
+    LayerShellQt::Shell::useLayerShell();
+    this->winId();
+    setup_layer_shell(this->windowHandle(), screen);
+
+    // An opaque panel background covers the whole panel, so no alpha channel is needed
+    if (!renderStyle(conf.panel_background_id).opaque)
+        setAttribute(Qt::WA_TranslucentBackground);
     setAttribute(Qt::WA_AlwaysShowToolTips);
     setWindowFlags(Qt::Window | Qt::FramelessWindowHint);
 
-    QScreen *screen = QApplication::primaryScreen();
     QRect screenGeometry = screen->geometry();
-    QString outputName;
-    for (QScreen *s : screen->virtualSiblings()) {
-        outputName = s->name();
-        screenGeometry = s->geometry();
-        if (outputName == conf.output) {
-            break;
-        }
-    }
-    info("use output '{}'", outputName.toStdString());
+    surfacePhase.end();
 
+    StartupPhase scenePhase("scene");
     QRect panelGeometry = screenGeometry;
     panelGeometry.setHeight(conf.panel_height);
     m_centralWidget = new QWidget;
@@ -202,12 +349,12 @@ Panel::Panel(QWidget *parent) : QMainWindow(parent)
     QStackedLayout *layout = new QStackedLayout;
     m_centralWidget->setLayout(layout);
 
-    View *view = new View(screenGeometry, &m_sfdo, m_centralWidget);
+    View *view = new View(screen, sfdo, toplevels, m_centralWidget);
     layout->addWidget(view);
+    m_opaqueRegion = view->opaqueRegion();
 
     setFixedSize(panelGeometry.size());
     setGeometry(panelGeometry);
-    layerShell->setExclusiveZone(conf.panel_height);
 
     /*
      * Layer shell surfaces are tied to a particular screen once shown.
@@ -217,43 +364,266 @@ Panel::Panel(QWidget *parent) : QMainWindow(parent)
     show();
 
     resize(screenGeometry.width(), conf.panel_height);
+    set_opaque_region(windowHandle(), m_opaqueRegion);
+    scenePhase.end();
 
-    connect(qApp, &QApplication::screenAdded, this, &Panel::updateGeometryDelayed);
+    connect(screen, &QScreen::geometryChanged, this, &Panel::updateGeometryDelayed);
 }
 
-Panel::~Panel()
-{
-    desktopEntryFinish(&m_sfdo);
-}
+Panel::~Panel() { }
 
 void Panel::updateGeometryDelayed()
 {
-    m_timer.setInterval(500);
-    m_timer.setSingleShot(true);
-    connect(&m_timer, &QTimer::timeout, this, &Panel::updateGeometry);
-    m_timer.start();
+    m_geometryTick.scheduleIn(std::chrono::milliseconds(500));
 }
 
 void Panel::updateGeometry()
 {
-    qDebug() << "updateGeometry";
-    QScreen *screen = QApplication::primaryScreen();
-    QRect screenGeometry = screen->geometry();
-    QString outputName;
-    for (QScreen *s : screen->virtualSiblings()) {
-        outputName = s->name();
-        screenGeometry = s->geometry();
-        if (outputName == conf.output) {
-            break;
-        }
+    info("update geometry of output '{}'", m_screen->name().toStdString());
+    hide();
+    show();
+    resize(m_screen->geometry().width(), conf.panel_height);
+    set_opaque_region(windowHandle(), m_opaqueRegion);
+}
+
+/*
+ * Direct renderer: a QRasterWindow which paints the scene items itself, without the widget
+ * stack and QGraphicsView. Damage comes from QGraphicsScene::changed and only the items
+ * intersecting it are painted, bottom to top, as a flat list. Input is forwarded to the scene
+ * the way QGraphicsView would.
+ */
+RasterPanel::RasterPanel(QScreen *screen, struct sfdo *sfdo, ToplevelSource *toplevels)
+    : m_screen{ screen }, m_painted{ false }, m_frames{ this }
+{
+    StartupPhase surfacePhase("layer-shell surface");
+    info("init layer-shell surface on output '{}' (raster)", screen->name().toStdString());
+    LayerShellQt::Shell::useLayerShell();
+    setup_layer_shell(this, screen);
+    setFlags(Qt::FramelessWindowHint);
+    surfacePhase.end();
+
+    StartupPhase scenePhase("scene");
+    m_scene = new PanelScene(screen, sfdo, toplevels);
+    m_opaqueRegion = m_scene->opaqueRegion();
+    connect(m_scene, &QGraphicsScene::changed, this, &RasterPanel::damage);
+    if (renderStyle(conf.panel_background_id).opaque) {
+        QSurfaceFormat opaque = format();
+        opaque.setAlphaBufferSize(0);
+        setFormat(opaque);
+    }
+    resize(screen->geometry().width(), conf.panel_height);
+    show();
+    set_opaque_region(this, m_opaqueRegion);
+    scenePhase.end();
+
+    connect(screen, &QScreen::geometryChanged, this, [this]() {
+        resize(m_screen->geometry().width(), conf.panel_height);
+        set_opaque_region(this, m_opaqueRegion);
+    });
+}
+
+RasterPanel::~RasterPanel()
+{
+    tickForgetVisible(this);
+    delete m_scene;
+}
+
+/*
+ * QRasterWindow::update() already waits for the next frame callback before painting; the frame
+ * scheduler only keeps count here.
+ */
+void RasterPanel::damage(const QList<QRectF> &rects)
+{
+    // Antialiased edges reach half a pixel beyond the bounding rectangles
+    for (const QRectF &rect : rects) {
+        QRect area = rect.toAlignedRect().adjusted(-1, -1, 1, 1);
+        m_frames.invalidate(area);
+        update(area);
+    }
+}
+
+void RasterPanel::paintEvent(QPaintEvent *event)
+{
+    uint64_t layouts = textLayoutCount();
+    uint64_t layers = staticLayerCount();
+    m_frames.take();
+    QPainter painter(this);
+    panelPaintItems(m_scene, &painter, event->region());
+    painter.end();
+    frame_painted(&m_painted, layouts, layers);
+}
+
+void panelPaintItems(QGraphicsScene *scene, QPainter *painter, const QRegion &region)
+{
+    painter->setClipRegion(region);
+    painter->setCompositionMode(QPainter::CompositionMode_Source);
+    painter->fillRect(region.boundingRect(), Qt::transparent);
+    painter->setCompositionMode(QPainter::CompositionMode_SourceOver);
+    painter->setRenderHint(QPainter::Antialiasing);
+
+    QStyleOptionGraphicsItem option;
+    for (QGraphicsItem *item : scene->items(QRectF(region.boundingRect()),
+                                            Qt::IntersectsItemBoundingRect, Qt::AscendingOrder)) {
+        if (!item->isVisible())
+            continue;
+        painter->save();
+        painter->setTransform(item->sceneTransform(), true);
+        option.exposedRect = item->boundingRect();
+        item->paint(painter, &option, nullptr);
+        painter->restore();
+    }
+}
+
+void RasterPanel::sendMouseEvent(QEvent::Type type, QMouseEvent *event)
+{
+    QGraphicsSceneMouseEvent mouseEvent(type);
+    QPointF pos = event->position();
+    mouseEvent.setScenePos(pos);
+    mouseEvent.setScreenPos(event->globalPosition().toPoint());
+    mouseEvent.setLastScenePos(m_lastMousePos);
+    mouseEvent.setLastScreenPos(mapToGlobal(m_lastMousePos.toPoint()));
+    mouseEvent.setButtonDownScenePos(event->button(), pos);
+    mouseEvent.setButtonDownScreenPos(event->button(), event->globalPosition().toPoint());
+    mouseEvent.setButton(event->button());
+    mouseEvent.setButtons(event->buttons());
+    mouseEvent.setModifiers(event->modifiers());
+    mouseEvent.setTimestamp(event->timestamp());
+    mouseEvent.setAccepted(false);
+    m_lastMousePos = pos;
+    QCoreApplication::sendEvent(m_scene, &mouseEvent);
+    event->setAccepted(mouseEvent.isAccepted());
+}
+
+void RasterPanel::mousePressEvent(QMouseEvent *event)
+{
+    sendMouseEvent(QEvent::GraphicsSceneMousePress, event);
+}
+
+void RasterPanel::mouseReleaseEvent(QMouseEvent *event)
+{
+    sendMouseEvent(QEvent::GraphicsSceneMouseRelease, event);
+}
+
+void RasterPanel::mouseDoubleClickEvent(QMouseEvent *event)
+{
+    sendMouseEvent(QEvent::GraphicsSceneMouseDoubleClick, event);
+}
+
+void RasterPanel::mouseMoveEvent(QMouseEvent *event)
+{
+    // Hover events are derived from these by the scene
+    sendMouseEvent(QEvent::GraphicsSceneMouseMove, event);
+}
+
+void RasterPanel::wheelEvent(QWheelEvent *event)
+{
+    QGraphicsSceneWheelEvent wheelEvent(QEvent::GraphicsSceneWheel);
+    wheelEvent.setScenePos(event->position());
+    wheelEvent.setScreenPos(event->globalPosition().toPoint());
+    wheelEvent.setButtons(event->buttons());
+    wheelEvent.setModifiers(event->modifiers());
+    wheelEvent.setDelta(event->angleDelta().y());
+    wheelEvent.setOrientation(Qt::Vertical);
+    wheelEvent.setPixelDelta(event->pixelDelta());
+    wheelEvent.setPhase(event->phase());
+    wheelEvent.setInverted(event->inverted());
+    wheelEvent.setAccepted(false);
+    QCoreApplication::sendEvent(m_scene, &wheelEvent);
+    event->setAccepted(wheelEvent.isAccepted());
+}
+
+bool RasterPanel::event(QEvent *event)
+{
+    if (event->type() == QEvent::Leave) {
+        /*
+         * The scene's own leave handling expects a view to have sent it. A move to outside the
+         * scene makes it send HoverLeave to whatever is hovered instead.
+         */
+        QGraphicsSceneMouseEvent moveEvent(QEvent::GraphicsSceneMouseMove);
+        QPointF outside = m_scene->sceneRect().topLeft() - QPointF(1, 1);
+        moveEvent.setScenePos(outside);
+        moveEvent.setScreenPos(mapToGlobal(outside.toPoint()));
+        moveEvent.setLastScenePos(m_lastMousePos);
+        moveEvent.setLastScreenPos(mapToGlobal(m_lastMousePos.toPoint()));
+        moveEvent.setAccepted(false);
+        m_lastMousePos = outside;
+        QCoreApplication::sendEvent(m_scene, &moveEvent);
+    } else if (event->type() == QEvent::Expose) {
+        tickSetVisible(this, isExposed());
     }
+    if (scale_may_change(event))
+        m_scene->setDevicePixelRatio(devicePixelRatio());
+    return QRasterWindow::event(event);
+}
+
+/* -o selects a single output, panel_outputs a subset; by default every output gets a panel */
+static bool wantsPanel(QScreen *screen)
+{
+    // Without any outputs Qt creates a dummy screen with no name
+    if (screen->name().isEmpty())
+        return false;
+    if (!conf.output.isEmpty())
+        return screen->name() == conf.output;
+    if (conf.panel_outputs.empty())
+        return true;
+    return std::ranges::contains(conf.panel_outputs, screen->name().toStdString());
+}
+
+PanelManager::PanelManager()
+{
+    /*
+     * Only the icon index is opened here. The desktop database and icon theme are loaded once the
+     * panels are mapped, and task icons are filled in as they become available.
+     */
+    info("load sfdo resources");
+    m_watcher = nullptr;
+    m_stats = conf.stats ? new StatsServer : nullptr;
+    desktopEntryInit(&m_sfdo);
+    iconCacheSetLimit((size_t)conf.icon_cache_size * 1024);
+
+    auto waylandApp = qGuiApp->nativeInterface<QNativeInterface::QWaylandApplication>();
+    m_toplevels = new ToplevelThread(waylandApp->display(), conf.record_toplevels);
+
+    for (QScreen *screen : QApplication::screens())
+        addPanel(screen);
+    if (m_panels.empty())
+        warn("no output matches; waiting for one to be connected");
+
+    connect(qApp, &QApplication::screenAdded, this, &PanelManager::addPanel);
+    connect(qApp, &QApplication::screenRemoved, this, &PanelManager::removePanel);
+    QTimer::singleShot(0, this, [this]() {
+        desktopEntryLoadAsync(&m_sfdo);
+        m_watcher = new ResourceWatcher(&m_sfdo);
+    });
+}
+
+PanelManager::~PanelManager()
+{
+    for (auto &[screen, panel] : m_panels)
+        delete panel;
+    delete m_watcher;
+    delete m_toplevels;
+    delete m_stats;
+    iconCacheFinish();
+    desktopEntryFinish(&m_sfdo);
+}
 
-    // No output is connected. Qt just creates a dummy one with no name.
-    if (outputName == "")
+void PanelManager::addPanel(QScreen *screen)
+{
+    if (!wantsPanel(screen) || m_panels.contains(screen))
         return;
+    if (conf.renderer == RENDERER_RASTER)
+        m_panels[screen] = new RasterPanel(screen, &m_sfdo, m_toplevels);
+    else
+        m_panels[screen] = new Panel(screen, &m_sfdo, m_toplevels);
+}
 
-    info("use output '{}'", outputName.toStdString());
-    hide();
-    show();
-    resize(screenGeometry.width(), conf.panel_height);
+void PanelManager::removePanel(QScreen *screen)
+{
+    auto it = m_panels.find(screen);
+    if (it == m_panels.end())
+        return;
+    info("remove panel from output '{}'", screen->name().toStdString());
+    delete it->second;
+    m_panels.erase(it);
 }
@@ -1,26 +1,155 @@
 // SPDX-License-Identifier: GPL-2.0-only
-#include <QDebug>
-#include <QGraphicsItem>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <QFontMetricsF>
 #include <QGraphicsScene>
+#include <QPainter>
 #include <QString>
-#include <QTimer>
-#include <QObject>
-#include <QtWidgets>
 #include "conf.h"
 #include "item-type.h"
 #include "plugin-clock.h"
+#include "stats.h"
 
-ClockItem::ClockItem(QObject *parent, int height) : QObject(parent)
+static enum clock_unit format_unit(const std::string &format)
+{
+    enum clock_unit unit = CLOCK_DAY;
+    for (size_t i = 0; i + 1 < format.size(); i++) {
+        if (format[i] != '%')
+            continue;
+        // Skip glibc flags, field width and the E and O modifiers
+        char c = format[++i];
+        while (c && strchr("_-0^#EO123456789", c) && i + 1 < format.size())
+            c = format[++i];
+        switch (c) {
+        case 'S':
+        case 's':
+        case 'T':
+        case 'r':
+        case 'X':
+        case 'c':
+        case '+':
+            return CLOCK_SECOND;
+        case 'M':
+        case 'R':
+            unit = std::min(unit, CLOCK_MINUTE);
+            break;
+        case 'H':
+        case 'I':
+        case 'k':
+        case 'l':
+        case 'p':
+        case 'P':
+            unit = std::min(unit, CLOCK_HOUR);
+            break;
+        default:
+            // Dates and '%%'
+            break;
+        }
+    }
+    return unit;
+}
+
+/* The next local time at which a clock showing @unit changes */
+static time_t next_boundary(time_t now, enum clock_unit unit)
+{
+    if (unit == CLOCK_SECOND)
+        return now + 1;
+    struct tm tm;
+    localtime_r(&now, &tm);
+    tm.tm_sec = 0;
+    if (unit == CLOCK_MINUTE) {
+        tm.tm_min++;
+    } else {
+        tm.tm_min = 0;
+        if (unit == CLOCK_HOUR) {
+            tm.tm_hour++;
+        } else {
+            tm.tm_hour = 0;
+            tm.tm_mday++;
+        }
+    }
+    tm.tm_isdst = -1;
+    return std::max(mktime(&tm), now + 1);
+}
+
+static QString format_time(const std::string &format, const struct tm &tm)
+{
+    if (format.empty())
+        return QString();
+    char buf[256];
+    size_t len = strftime(buf, sizeof(buf), format.c_str(), &tm);
+    return QString::fromLocal8Bit(buf, len);
+}
+
+/*
+ * Width of the widest text @format produces, measured once so that the clock never changes size:
+ * digits are replaced by the widest digit, and a week of days and a day of every month, each
+ * before and after noon, cover the names of days and months and the AM/PM markers.
+ */
+static qreal measure_format(const std::string &format, const QFont &font)
+{
+    if (format.empty())
+        return 0;
+    QFontMetricsF metrics(font);
+    QChar widest = '0';
+    for (char c = '1'; c <= '9'; c++) {
+        if (metrics.horizontalAdvance(QChar(c)) > metrics.horizontalAdvance(widest))
+            widest = QChar(c);
+    }
+
+    time_t now = time(nullptr);
+    struct tm today;
+    localtime_r(&now, &today);
+    qreal width = 0;
+    for (int i = 0; i < 7 + 12; i++) {
+        // An hour before and after noon for the AM/PM markers
+        for (int hour : { 1, 13 }) {
+            struct tm sample = today;
+            if (i < 7) {
+                sample.tm_mday += i;
+            } else {
+                sample.tm_mon = i - 7;
+                sample.tm_mday = 1;
+            }
+            sample.tm_hour = hour;
+            sample.tm_isdst = -1;
+            mktime(&sample);
+            QString text = format_time(format, sample);
+            for (QChar &c : text) {
+                if (c.isDigit())
+                    c = widest;
+            }
+            width = std::max(width, metrics.horizontalAdvance(text));
+        }
+    }
+    return width;
+}
+
+// Late enough to share wake-ups with other sources, early enough not to be noticed
+static constexpr std::chrono::milliseconds CLOCK_TOLERANCE(50);
+
+ClockItem::ClockItem(QObject *parent, int height)
+    : QObject(parent), m_tick("clock", CLOCK_TOLERANCE, /* essential */ false, [this]() {
+          setTime();
+          arm();
+      })
 {
     m_height = height;
+    m_unit = std::min(format_unit(conf.time1_format), format_unit(conf.time2_format));
 
-    m_text = "MM:MM";
-    QFontMetrics fm(conf.time1_font);
-    m_width = fm.horizontalAdvance(m_text) + 3 + 3 + 1;
-    m_text = QDateTime::currentDateTime().toString("hh:mm");
+    qreal width = std::max(measure_format(conf.time1_format, conf.time1_font),
+                           measure_format(conf.time2_format, conf.time2_font));
+    m_width = std::ceil(width) + 3 + 3 + 1;
+    m_line1Height = QFontMetricsF(conf.time1_font).height();
+    m_textHeight = m_line1Height;
+    if (!conf.time2_format.empty())
+        m_textHeight += QFontMetricsF(conf.time2_font).height();
 
-    QObject::connect(&m_timer, &QTimer::timeout, this, &ClockItem::setTime);
-    m_timer.start(1000);
+    setTime();
+    arm();
 }
 
 ClockItem::~ClockItem() { }
@@ -36,29 +165,52 @@ QRectF ClockItem::fullDrawingRect()
     return boundingRect().adjusted(halfPenWidth, halfPenWidth, -halfPenWidth, -halfPenWidth);
 }
 
+/* The lines of text, centred vertically */
+QRectF ClockItem::textRect(void)
+{
+    // TODO: add config padding stuff here
+    QRectF rect = fullDrawingRect().adjusted(3, 0, -6, 0);
+    rect.setTop(rect.top() + (rect.height() - m_textHeight) / 2.0);
+    rect.setHeight(m_textHeight);
+    return rect;
+}
+
 void ClockItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *, QWidget *)
 {
-    QPen pen(QColor(conf.backgrounds.at(conf.clock_background_id)->border_color));
-    pen.setStyle(Qt::SolidLine);
-    pen.setWidth(conf.penWidth);
-    painter->setPen(pen);
-    painter->setBrush(conf.backgrounds.at(conf.clock_background_id)->background_color);
-    painter->drawRect(fullDrawingRect());
+    StatsPaintTimer timer(PANEL_TYPE_CLOCK);
+    renderStyleDrawRect(painter, fullDrawingRect(), renderStyle(conf.clock_background_id));
 
-    painter->setFont(conf.time1_font);
     painter->setPen(conf.clock_font_color);
-    // TODO: add config padding stuff here
-    QRectF rect = fullDrawingRect().adjusted(3, 0, -6, 0);
-    QFontMetrics metrics(conf.time1_font);
-    QString text = metrics.elidedText(m_text, Qt::ElideRight, rect.width());
-    painter->drawText(rect, Qt::AlignCenter | Qt::AlignVCenter, text);
+    QRectF rect = textRect();
+    painter->setFont(conf.time1_font);
+    const QStaticText &line1 = m_layout1.layout(m_time1, conf.time1_font, rect.width());
+    painter->drawStaticText(
+            QPointF(rect.left() + (rect.width() - line1.size().width()) / 2.0, rect.top()), line1);
+    if (!m_time2.isEmpty()) {
+        painter->setFont(conf.time2_font);
+        const QStaticText &line2 = m_layout2.layout(m_time2, conf.time2_font, rect.width());
+        painter->drawStaticText(QPointF(rect.left() + (rect.width() - line2.size().width()) / 2.0,
+                                        rect.top() + m_line1Height),
+                                line2);
+    }
 }
 
 void ClockItem::setTime()
 {
-    QString text = QDateTime::currentDateTime().toString("hh:mm");
-    if (text == m_text)
+    time_t now = time(nullptr);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    QString time1 = format_time(conf.time1_format, tm);
+    QString time2 = format_time(conf.time2_format, tm);
+    if (time1 == m_time1 && time2 == m_time2)
         return;
-    m_text = text;
-    update();
+    m_time1 = time1;
+    m_time2 = time2;
+    // The background stays the same
+    update(textRect());
+}
+
+void ClockItem::arm(void)
+{
+    m_tick.schedule(std::chrono::system_clock::from_time_t(next_boundary(time(nullptr), m_unit)));
 }
@@ -1,32 +1,68 @@
 // SPDX-License-Identifier: GPL-2.0-only
+#include <algorithm>
+#include <cmath>
+#include <optional>
+#include <ranges>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 #include <QDebug>
 #include <QDirIterator>
 #include <QGraphicsItem>
 #include <QGuiApplication>
 #include <QGraphicsScene>
 #include <QGraphicsSceneMouseEvent>
+#include <QGraphicsSceneWheelEvent>
 #include <QIcon>
 #include <QMouseEvent>
 #include <QString>
 #include <QToolButton>
 #include <QTextStream>
-#include <poll.h>
-#include <pthread.h>
 #include <wayland-client.h>
 #include <qpa/qplatformnativeinterface.h>
 #include "conf.h"
+#include "icon-cache.h"
 #include "log.h"
 #include "item-type.h"
 #include "panel.h"
 #include "plugin-taskbar.h"
-#include "wlr-foreign-toplevel-management-unstable-v1.h"
+#include "stats.h"
+#include "text-layout.h"
+#include "toplevel-source.h"
+
+/*
+ * Plain data for one foreign toplevel. Every window has one of these, but only the ones in a
+ * visible slot have a Task item in the scene.
+ */
+struct toplevel {
+    uint32_t id;
+    uint32_t state;
+    std::string title;
+    std::string app_id;
+    std::vector<struct wl_output *> outputs;
+    // Item showing this toplevel, if it is in a visible slot
+    Task *task;
+};
 
+/*
+ * A visible taskbar slot, showing either one toplevel or, with taskbar_grouping, all toplevels
+ * sharing an app_id. Items are reused as slots come and go.
+ */
 class Task : public QGraphicsItem
 {
 public:
-    Task(QGraphicsItem *parent, struct zwlr_foreign_toplevel_handle_v1 *handle);
+    Task(Taskbar *taskbar);
     ~Task();
 
+    const std::string &appId() const { return m_app_id; }
+    qreal iconScale() const { return m_iconScale; }
+    void bind(const std::vector<struct toplevel *> &toplevels);
+    void refresh(void);
+    void requestIcon(void);
+    void setIconScale(qreal scale);
+    void setWidth(int width);
+
     enum { Type = UserType + PANEL_TYPE_TASK };
     int type() const override { return Type; }
 
@@ -42,100 +78,113 @@ protected:
     void hoverLeaveEvent(QGraphicsSceneHoverEvent *) override;
 
 private:
-    struct zwlr_foreign_toplevel_handle_v1 *m_handle;
+    std::vector<struct toplevel *> m_toplevels;
     uint32_t m_state;
     Taskbar *m_taskbar;
+    int m_width;
     std::string m_app_id;
+    QString m_label;
+    TextLayout m_labelLayout;
+    QString m_count;
+    TextLayout m_countLayout;
     QPixmap m_icon;
+    qreal m_iconScale;
+    icon_ticket m_iconTicket;
     bool m_hover;
 };
 
-static QPixmap getIcon(struct sfdo *sfdo, const char *app_id)
+/*
+ * Apply everything received up to a 'done' event. Returns true if the task showing the toplevel
+ * needs a repaint; sets @regroup if the slots have to be rebuilt instead.
+ */
+static bool toplevel_commit(struct toplevel *toplevel, const struct task_pending &pending,
+                            bool *regroup)
 {
-    int size = 22;
-    float scale = 1.0;
-    std::string name = load_icon_from_app_id(sfdo, app_id, size, scale);
-    QPixmap pixmap = name.empty() ? QPixmap()
-                                  : QIcon(QString::fromStdString(name)).pixmap(QSize(size, size));
-    return pixmap;
+    bool dirty = false;
+
+    // The title is not drawn, so a new one does not need a repaint
+    if (pending.title)
+        toplevel->title = *pending.title;
+
+    if (pending.app_id && *pending.app_id != toplevel->app_id) {
+        toplevel->app_id = *pending.app_id;
+        dirty = true;
+        if (conf.taskbar_grouping)
+            *regroup = true;
+    }
+
+    if (pending.state && *pending.state != toplevel->state) {
+        toplevel->state = *pending.state;
+        dirty = true;
+    }
+
+    for (auto output : pending.outputs_left)
+        std::erase(toplevel->outputs, output);
+    for (auto output : pending.outputs_entered) {
+        if (std::ranges::find(toplevel->outputs, output) == toplevel->outputs.end())
+            toplevel->outputs.push_back(output);
+    }
+
+    return dirty;
 }
 
-Task::Task(QGraphicsItem *parent, struct zwlr_foreign_toplevel_handle_v1 *handle)
-    : m_state{ 0 }
+Task::Task(Taskbar *taskbar) : m_state{ 0 }
 {
-    m_handle = handle;
-    m_taskbar = static_cast<Taskbar *>(parent);
+    m_taskbar = taskbar;
+    m_width = m_taskbar->taskWidth();
     m_hover = false;
+    m_iconScale = taskbar->iconScale();
+    m_iconTicket = 0;
 
     setAcceptHoverEvents(true);
-
-    static const zwlr_foreign_toplevel_handle_v1_listener toplevel_handle_impl = {
-        .title =
-                [](void *data, zwlr_foreign_toplevel_handle_v1 *handle, const char *title) {
-                    // static_cast<Task *>(data)->setText(QString(title).replace("&", "&&"));
-                },
-        .app_id =
-                [](void *data, zwlr_foreign_toplevel_handle_v1 *handle, const char *app_id) {
-                    auto self = static_cast<Task *>(data);
-                    self->m_app_id = app_id;
-                    self->m_icon = getIcon(self->m_taskbar->sfdo(), app_id);
-                    self->update();
-                },
-        .output_enter =
-                [](void *data, zwlr_foreign_toplevel_handle_v1 *handle, wl_output *output) {
-                    // no-op
-                },
-        .output_leave =
-                [](void *data, zwlr_foreign_toplevel_handle_v1 *handle, wl_output *output) {
-                    // no-op
-                },
-        .state =
-                [](void *data, zwlr_foreign_toplevel_handle_v1 *handle, wl_array *state) {
-                    auto self = static_cast<Task *>(data);
-                    self->m_state = 0;
-                    for (size_t i = 0; i < state->size / sizeof(uint32_t); ++i) {
-                        uint32_t elm = static_cast<uint32_t *>(state->data)[i];
-                        switch (elm) {
-                        case ZWLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_ACTIVATED:
-                            self->m_state |= TASK_ACTIVE;
-                            break;
-                        case ZWLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_MINIMIZED:
-                            self->m_state |= TASK_MINIMIZED;
-                            break;
-                        default:
-                            break;
-                        }
-                    }
-                    self->update();
-                },
-        .done =
-                [](void *data, zwlr_foreign_toplevel_handle_v1 *handle) {
-                    // no-op
-                },
-        .closed =
-                [](void *data, zwlr_foreign_toplevel_handle_v1 *handle) {
-                    auto self = static_cast<Task *>(data);
-                    auto taskbar = self->m_taskbar;
-                    zwlr_foreign_toplevel_handle_v1_destroy(self->m_handle);
-                    self->m_handle = nullptr;
-                    delete (self);
-                    taskbar->updateTasks();
-                },
-        .parent =
-                [](void *data, zwlr_foreign_toplevel_handle_v1 *handle,
-                   zwlr_foreign_toplevel_handle_v1 *parent) {
-                    // no-op
-                },
-    };
-
-    zwlr_foreign_toplevel_handle_v1_add_listener(m_handle, &toplevel_handle_impl, this);
 }
 
 Task::~Task()
 {
-    if (m_handle) {
-        zwlr_foreign_toplevel_handle_v1_destroy(m_handle);
+    iconCacheCancel(m_iconTicket);
+}
+
+void Task::bind(const std::vector<struct toplevel *> &toplevels)
+{
+    m_toplevels = toplevels;
+    for (auto toplevel : m_toplevels)
+        toplevel->task = this;
+    refresh();
+}
+
+/* Pick up changes of the bound toplevels; repaints only if something drawn changed */
+void Task::refresh(void)
+{
+    bool dirty = false;
+
+    const std::string &app_id = m_toplevels.front()->app_id;
+    if (app_id != m_app_id) {
+        m_app_id = app_id;
+        m_label = QString::fromStdString(m_app_id);
+        requestIcon();
+        dirty = true;
+    }
+
+    // A group is active if any of its windows is, and minimized only if all of them are
+    uint32_t state = TASK_MINIMIZED;
+    for (auto toplevel : m_toplevels) {
+        state |= toplevel->state & TASK_ACTIVE;
+        if (!(toplevel->state & TASK_MINIMIZED))
+            state &= ~TASK_MINIMIZED;
+    }
+    if (state != m_state) {
+        m_state = state;
+        dirty = true;
     }
+
+    QString count = m_toplevels.size() > 1 ? QString::number(m_toplevels.size()) : QString();
+    if (count != m_count) {
+        m_count = count;
+        dirty = true;
+    }
+
+    if (dirty)
+        update();
 }
 
 int itemHeight(void)
@@ -144,50 +193,122 @@ int itemHeight(void)
     return conf.panel_height - conf.taskbar_padding.vertical * 2;
 }
 
+/* Icons fill the task height, leaving a 2.5px margin */
+static int iconSize(void)
+{
+    int taskHeight = itemHeight() - 1 - 2 * conf.taskbar_padding.vertical;
+    return std::max(taskHeight - 5, 1);
+}
+
+/*
+ * Icons are resolved and decoded off the GUI thread, rasterized at exactly iconSize() device
+ * pixels for the scale of the panel window. Until the new icon arrives the previous one (if any)
+ * stays on screen, otherwise paint() draws a placeholder. Never called from paint(): a cached
+ * icon is delivered right away, and would trigger an update() while painting.
+ */
+void Task::requestIcon(void)
+{
+    iconCacheCancel(m_iconTicket);
+    m_iconTicket = iconCacheRequest(m_taskbar->sfdo(), m_app_id, iconSize(), m_iconScale,
+                                    [this](const QPixmap &pixmap) {
+                                        m_iconTicket = 0;
+                                        m_icon = pixmap;
+                                        update();
+                                    });
+}
+
+/* Moved to an output with a different scale; draw the old icon until the new one arrives */
+void Task::setIconScale(qreal scale)
+{
+    if (scale == m_iconScale)
+        return;
+    m_iconScale = scale;
+    if (!m_app_id.empty())
+        requestIcon();
+}
+
+void Task::setWidth(int width)
+{
+    if (width == m_width)
+        return;
+    prepareGeometryChange();
+    m_width = width;
+}
+
 QRectF Task::boundingRect() const
 {
     return QRectF(0.5 + conf.taskbar_padding.horizontal, 0.5 + conf.taskbar_padding.vertical,
-                  m_taskbar->taskWidth() - 1.0 - 2.0 * conf.taskbar_padding.horizontal,
+                  m_width - 1.0 - 2.0 * conf.taskbar_padding.horizontal,
                   itemHeight() - 1.0 - 2.0 * conf.taskbar_padding.vertical);
 }
 
 void Task::paint(QPainter *painter, const QStyleOptionGraphicsItem *, QWidget *)
 {
-    QPen pen(QColor(conf.backgrounds.at(conf.task_active_background_id)->border_color));
-    pen.setStyle(Qt::SolidLine);
-    pen.setWidth(conf.penWidth);
-
-    int radius = 0;
+    StatsPaintTimer timer(PANEL_TYPE_TASK);
+    const struct render_style &style = renderStyle(conf.task_background_id);
+    const struct render_style &active_style = renderStyle(conf.task_active_background_id);
     if (m_state & TASK_ACTIVE) {
-        painter->setPen(pen);
-        painter->setBrush(conf.backgrounds.at(conf.task_active_background_id)->background_color);
-        radius = conf.backgrounds.at(conf.task_active_background_id)->rounded;
+        renderStyleDrawShape(painter, boundingRect(), active_style);
+    } else if (m_hover) {
+        renderStyleDrawShape(painter, boundingRect(), style, &active_style.pen);
     } else {
-        painter->setPen(m_hover ? pen : Qt::NoPen);
-        painter->setBrush(conf.backgrounds.at(conf.task_background_id)->background_color);
-        radius = conf.backgrounds.at(conf.task_background_id)->rounded;
+        // The plain shape is the same for every inactive task, so it is rasterized once
+        QRectF area(0, 0, m_width, itemHeight());
+        m_taskbar->taskShape().draw(painter, area, [this, &style](QPainter *painter) {
+            static const QPen no_pen(Qt::NoPen);
+            renderStyleDrawShape(painter, boundingRect(), style, &no_pen);
+        });
     }
 
-    QPainterPath path;
-    path.addRoundedRect(boundingRect(), radius, radius);
-    painter->drawPath(path);
-
     // Icon
+    qreal scale = painter->device()->devicePixelRatioF();
+    int size = iconSize();
+    QRectF content = boundingRect();
+    qreal margin = (content.height() - size) / 2.0;
+    QRectF target(content.left() + margin, content.top() + margin, size, size);
     if (!m_icon.isNull()) {
-        int size = 22;
-        int offset = 5;
-        QRect target(offset, offset, size, size);
-        QRect source(0, 0, size, size);
-        painter->drawPixmap(target, m_icon, source);
+        // Align to the device pixel grid so that the pixmap is blitted without resampling
+        QTransform device = painter->deviceTransform();
+        QPointF topLeft = device.map(target.topLeft());
+        topLeft = device.inverted().map(QPointF(std::round(topLeft.x()), std::round(topLeft.y())));
+        if (m_icon.devicePixelRatio() == scale)
+            painter->drawPixmap(topLeft, m_icon);
+        else
+            painter->drawPixmap(QRectF(topLeft, target.size()), m_icon, m_icon.rect());
+    } else if (m_iconTicket) {
+        QColor placeholder = conf.task_font_color;
+        placeholder.setAlpha(placeholder.alpha() / 4);
+        painter->setPen(Qt::NoPen);
+        painter->setBrush(placeholder);
+        painter->drawRoundedRect(target, 3, 3);
+    }
+
+    // Number of windows in a group
+    if (!m_count.isEmpty()) {
+        QFont font = conf.task_font;
+        font.setPointSizeF(font.pointSizeF() * 0.75);
+        const QStaticText &count = m_countLayout.layout(m_count, font, size);
+        QSizeF badge = count.size() + QSizeF(4, 0);
+        badge.setWidth(std::max(badge.width(), badge.height()));
+        QRectF rect(target.bottomRight() - QPointF(badge.width(), badge.height()) + QPointF(2, 2),
+                    badge);
+        painter->setPen(Qt::NoPen);
+        painter->setBrush(conf.task_font_color);
+        painter->drawRoundedRect(rect, badge.height() / 2, badge.height() / 2);
+        painter->setFont(font);
+        // The task background may be transparent, so contrast with the badge itself
+        painter->setPen(qGray(conf.task_font_color.rgb()) > 127 ? Qt::black : Qt::white);
+        qreal x = (badge.width() - count.size().width()) / 2;
+        painter->drawStaticText(rect.topLeft() + QPointF(x, 0), count);
     }
 
     // Text
     painter->setFont(conf.task_font);
     painter->setPen(conf.task_font_color);
-    QRectF rect = boundingRect().adjusted(3 + 22 + 2 + 2, 0, -6, 0);
-    QFontMetrics metrics(conf.task_font);
-    QString s = metrics.elidedText(QString::fromStdString(m_app_id), Qt::ElideRight, rect.width());
-    painter->drawText(rect, Qt::AlignLeft | Qt::AlignVCenter, s);
+    QRectF rect = boundingRect().adjusted(2 * margin + size + 2, 0, -6, 0);
+    const QStaticText &text = m_labelLayout.layout(m_label, conf.task_font, rect.width());
+    qreal y = rect.top() + (rect.height() - text.size().height()) / 2.0;
+    painter->drawStaticText(QPointF(rect.left(), y), text);
 }
 
 void Task::mouseDoubleClickEvent(QGraphicsSceneMouseEvent *event)
@@ -195,17 +316,35 @@ void Task::mouseDoubleClickEvent(QGraphicsSceneMouseEvent *event)
     // No-op
 }
 
+static void activate(ToplevelSource *source, struct toplevel *toplevel)
+{
+    if (toplevel->state & TASK_MINIMIZED) {
+        source->request(toplevel->id, TOPLEVEL_UNSET_MINIMIZED, nullptr);
+    } else {
+        auto waylandApp = qGuiApp->nativeInterface<QNativeInterface::QWaylandApplication>();
+        source->request(toplevel->id, TOPLEVEL_ACTIVATE, waylandApp->seat());
+    }
+}
+
 void Task::mousePressEvent(QGraphicsSceneMouseEvent *event)
 {
-    // Traditional minimize-raise action
+    /*
+     * Traditional minimize-raise action. For groups, clicking the active group cycles through
+     * its windows and only minimizes once there is nothing else to cycle to.
+     */
     if (event->button() == Qt::LeftButton) {
-        if (m_state & TASK_MINIMIZED) {
-            zwlr_foreign_toplevel_handle_v1_unset_minimized(m_handle);
-        } else if (m_state & TASK_ACTIVE) {
-            zwlr_foreign_toplevel_handle_v1_set_minimized(m_handle);
+        auto active = std::ranges::find_if(m_toplevels, [](struct toplevel *toplevel) {
+            return toplevel->state & TASK_ACTIVE;
+        });
+        ToplevelSource *source = m_taskbar->toplevelSource();
+        if (active == m_toplevels.end()) {
+            activate(source, m_toplevels.front());
+        } else if (m_toplevels.size() == 1) {
+            source->request((*active)->id, TOPLEVEL_SET_MINIMIZED, nullptr);
         } else {
-            auto waylandApp = qGuiApp->nativeInterface<QNativeInterface::QWaylandApplication>();
-            zwlr_foreign_toplevel_handle_v1_activate(m_handle, waylandApp->seat());
+            auto next = std::next(active) == m_toplevels.end() ? m_toplevels.begin()
+                                                                : std::next(active);
+            activate(source, *next);
         }
     }
 
@@ -231,39 +370,55 @@ void Task::hoverLeaveEvent(QGraphicsSceneHoverEvent *)
     update();
 }
 
-Taskbar::Taskbar(QGraphicsScene *scene, int height, int width, struct sfdo *sfdo) : m_scene{ scene }
+Taskbar::Taskbar(QGraphicsScene *scene, int height, int width, struct sfdo *sfdo,
+                 ToplevelSource *source, struct wl_output *output)
+    : m_scene{ scene }, m_toplevelSource{ source }, m_output{ output }
 {
     m_height = height;
     m_width = width;
     m_sfdo = sfdo;
+    m_iconScale = 1.0;
+    m_taskWidth = 0;
+    m_firstSlot = 0;
+    setFlag(ItemSendsGeometryChanges);
+    updateTasks();
 
-    static const wl_registry_listener registry_listener_impl = {
-        .global =
-                [](void *data, wl_registry *registry, uint32_t name, const char *interface,
-                   uint32_t version) {
-                    auto self = static_cast<Taskbar *>(data);
-                    if (!strcmp(interface, zwlr_foreign_toplevel_manager_v1_interface.name)) {
-                        self->addForeignToplevelManager(registry, name, version);
-                    }
-                },
-        .global_remove =
-                [](void *data, wl_registry *registry, uint32_t name) {
-                    /* no-op */
+    m_toplevelSource->addHandler(this, [this](const std::vector<struct toplevel_update> &updates) {
+        applyUpdates(updates);
+    });
+
+    // Icons of apps that were (re)installed while running
+    iconCacheAddInvalidateHandler(
+            this,
+            [this](std::vector<struct icon_lookup> *lookups) {
+                for (Task *task : m_tasks) {
+                    if (!task->appId().empty())
+                        lookups->push_back({ task->appId(), iconSize(), (float)task->iconScale() });
                 }
-    };
-
-    auto waylandApp = qGuiApp->nativeInterface<QNativeInterface::QWaylandApplication>();
-    m_registry = wl_display_get_registry(waylandApp->display());
-    wl_registry_add_listener(m_registry, &registry_listener_impl, this);
+            },
+            [this](const std::unordered_set<std::string> &app_ids) {
+                for (Task *task : m_tasks) {
+                    if (app_ids.contains(task->appId()))
+                        task->requestIcon();
+                }
+            });
 }
 
 Taskbar::~Taskbar()
 {
-    if (m_foreignToplevelManager) {
-        zwlr_foreign_toplevel_manager_v1_destroy(m_foreignToplevelManager);
-        m_foreignToplevelManager = nullptr;
-    }
-    wl_registry_destroy(m_registry);
+    iconCacheRemoveInvalidateHandler(this);
+    m_toplevelSource->removeHandler(this);
+    for (auto toplevel : m_toplevels)
+        delete toplevel;
+}
+
+void Taskbar::setIconScale(qreal scale)
+{
+    if (scale == m_iconScale)
+        return;
+    m_iconScale = scale;
+    for (Task *task : m_tasks)
+        task->setIconScale(scale);
 }
 
 QRectF Taskbar::boundingRect() const
@@ -279,45 +434,106 @@ QRectF Taskbar::fullDrawingRect()
 
 void Taskbar::paint(QPainter *painter, const QStyleOptionGraphicsItem *, QWidget *)
 {
-    QPen pen(QColor(conf.backgrounds.at(conf.taskbar_background_id)->border_color));
-    pen.setStyle(Qt::SolidLine);
-    pen.setWidth(conf.penWidth);
-    painter->setPen(pen);
-    painter->setBrush(conf.backgrounds.at(conf.taskbar_background_id)->background_color);
-    painter->drawRect(fullDrawingRect());
+    StatsPaintTimer timer(PANEL_TYPE_TASKBAR);
+    m_layer.draw(painter, boundingRect(), [this](QPainter *painter) {
+        renderStyleDrawRect(painter, fullDrawingRect(), renderStyle(conf.taskbar_background_id));
+    });
 }
 
-void Taskbar::addTask(struct zwlr_foreign_toplevel_handle_v1 *handle)
+/*
+ * Windows are shown on the panel of each output they are on. Some compositors never send
+ * output_enter, so windows which are on no output at all are shown everywhere.
+ */
+bool Taskbar::isShown(const struct toplevel *toplevel) const
 {
-    m_scene->addItem(new Task(this, handle));
-    updateTasks();
+    return !m_output || toplevel->outputs.empty()
+            || std::ranges::find(toplevel->outputs, m_output) != toplevel->outputs.end();
 }
 
-void Taskbar::updateTasks(void)
+/* Apply one batch of protocol changes, rebuilding the slots or repainting each task at most once */
+void Taskbar::applyUpdates(const std::vector<struct toplevel_update> &updates)
 {
-    int width = taskWidth();
-    int i = 0;
-    foreach (QGraphicsItem *item, m_scene->items()) {
-        if (Task *p = qgraphicsitem_cast<Task *>(item)) {
-            int margin = (conf.panel_height - itemHeight()) / 2;
-            int y = margin;
-            int x = this->x() + margin + i * (width + conf.taskbar_padding.spacing);
-            p->setPos(x, y);
-            i++;
+    bool relayout = false;
+    std::vector<Task *> dirty;
+    for (auto &update : updates) {
+        if (update.added) {
+            m_toplevels.push_back(new struct toplevel {
+                    .id = update.id,
+                    .state = 0,
+                    .task = nullptr,
+            });
+            relayout = true;
+        }
+
+        // Ids increase monotonically, so the toplevels are sorted by id
+        auto it = std::ranges::lower_bound(m_toplevels, update.id, {}, &toplevel::id);
+        if (it == m_toplevels.end() || (*it)->id != update.id)
+            continue;
+
+        if (update.closed) {
+            delete *it;
+            m_toplevels.erase(it);
+            relayout = true;
+        } else {
+            bool shown = isShown(*it);
+            if (toplevel_commit(*it, update.pending, &relayout) && (*it)->task)
+                dirty.push_back((*it)->task);
+            // Moved to or away from this panel's output
+            if (isShown(*it) != shown)
+                relayout = true;
         }
     }
+
+    // Tasks may still refer to closed toplevels until the slots are rebuilt
+    if (relayout) {
+        updateTasks();
+    } else {
+        for (Task *task : dirty)
+            task->refresh();
+    }
+}
+
+/* Minimum task width; by default just wide enough for the icon */
+static int minimumTaskWidth(void)
+{
+    if (conf.task_minimum_size)
+        return conf.task_minimum_size;
+    return iconSize() + 6 + 2 * conf.taskbar_padding.horizontal;
 }
 
-int Taskbar::taskWidth(void)
+/*
+ * Recompute slots, task width and positions once per change of the toplevel list, so that
+ * painting and boundingRect() of individual tasks do not depend on the number of windows.
+ *
+ * Slots that do not fit at the minimum task width are not shown (the mouse wheel scrolls through
+ * them) and own no scene item, so the cost of the scene stays bounded by the taskbar width.
+ */
+void Taskbar::updateTasks(void)
 {
-    int nrItems = 0;
-    foreach (QGraphicsItem *item, m_scene->items()) {
-        if (item->type() == QGraphicsItem::UserType + PANEL_TYPE_TASK) {
-            ++nrItems;
+    auto shown = [this](struct toplevel *toplevel) { return isShown(toplevel); };
+    std::vector<std::vector<struct toplevel *>> slots;
+    if (conf.taskbar_grouping) {
+        std::unordered_map<std::string_view, size_t> groups;
+        for (auto toplevel : m_toplevels | std::views::filter(shown)) {
+            auto [it, added] = groups.emplace(toplevel->app_id, slots.size());
+            if (added)
+                slots.emplace_back();
+            slots[it->second].push_back(toplevel);
         }
+    } else {
+        for (auto toplevel : m_toplevels | std::views::filter(shown))
+            slots.push_back({ toplevel });
     }
-    int width = m_width;
-    width -= conf.taskbar_padding.horizontal * 2;
+
+    int nrSlots = slots.size();
+    int available = m_width - conf.taskbar_padding.horizontal * 2;
+    int nrItems = nrSlots;
+    int minimum = minimumTaskWidth();
+    if (nrItems && (available - conf.taskbar_padding.spacing * (nrItems - 1)) / nrItems < minimum)
+        nrItems = std::max(1, (available + conf.taskbar_padding.spacing)
+                                      / (minimum + conf.taskbar_padding.spacing));
+
+    int width = available;
     if (nrItems) {
         width -= conf.taskbar_padding.spacing * (nrItems - 1);
         width /= nrItems;
@@ -325,29 +541,45 @@ int Taskbar::taskWidth(void)
     if (conf.task_maximum_size && width > conf.task_maximum_size) {
         width = conf.task_maximum_size;
     }
-    return width;
+    m_taskWidth = width;
+    m_firstSlot = std::clamp(m_firstSlot, 0, nrSlots - nrItems);
+
+    while ((int)m_tasks.size() > nrItems) {
+        delete m_tasks.back();
+        m_tasks.pop_back();
+    }
+    while ((int)m_tasks.size() < nrItems) {
+        m_tasks.push_back(new Task(this));
+        m_scene->addItem(m_tasks.back());
+    }
+
+    for (auto toplevel : m_toplevels)
+        toplevel->task = nullptr;
+
+    int margin = (conf.panel_height - itemHeight()) / 2;
+    for (int i = 0; i < nrItems; i++) {
+        int y = margin;
+        int x = this->x() + margin + i * (width + conf.taskbar_padding.spacing);
+        m_tasks[i]->bind(slots[m_firstSlot + i]);
+        m_tasks[i]->setWidth(width);
+        m_tasks[i]->setPos(x, y);
+    }
 }
 
-void Taskbar::addForeignToplevelManager(struct wl_registry *registry, uint32_t name,
-                                        uint32_t version)
+/*
+ * Tasks are positioned in scene coordinates. Existing toplevels are handed over while the
+ * taskbar is constructed, before it is moved into place, so follow it.
+ */
+QVariant Taskbar::itemChange(GraphicsItemChange change, const QVariant &value)
 {
-    m_foreignToplevelManager = static_cast<struct zwlr_foreign_toplevel_manager_v1 *>(
-            wl_registry_bind(registry, name, &zwlr_foreign_toplevel_manager_v1_interface, version));
-    if (!m_foreignToplevelManager)
-        die("foreign-toplevel-management protocol not supported by compositor");
-
-    static const zwlr_foreign_toplevel_manager_v1_listener toplevel_manager_impl = {
-        .toplevel =
-                [](void *data, zwlr_foreign_toplevel_manager_v1 *manager,
-                   zwlr_foreign_toplevel_handle_v1 *handle) {
-                    static_cast<Taskbar *>(data)->addTask(handle);
-                },
-        .finished =
-                [](void *data, zwlr_foreign_toplevel_manager_v1 *manager) {
-                    /* no-op */
-                },
-    };
-
-    zwlr_foreign_toplevel_manager_v1_add_listener(m_foreignToplevelManager, &toplevel_manager_impl,
-                                                  this);
+    if (change == ItemPositionHasChanged)
+        updateTasks();
+    return QGraphicsItem::itemChange(change, value);
+}
+
+void Taskbar::wheelEvent(QGraphicsSceneWheelEvent *event)
+{
+    m_firstSlot += event->delta() > 0 ? -1 : 1;
+    updateTasks();
+    event->accept();
 }
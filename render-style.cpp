@@ -0,0 +1,116 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <algorithm>
+#include <cmath>
+#include "conf.h"
+#include "log.h"
+#include "render-style.h"
+
+static constexpr size_t MAX_PATHS = 4;
+
+static std::vector<struct render_style> styles;
+
+void renderStylesInit(void)
+{
+    styles.clear();
+    styles.reserve(conf.backgrounds.size());
+    for (auto &background : conf.backgrounds) {
+        struct render_style style;
+        if (background->border_color.alpha()) {
+            style.pen = QPen(background->border_color);
+            style.pen.setStyle(Qt::SolidLine);
+            style.pen.setWidthF(conf.penWidth);
+        } else {
+            style.pen = QPen(Qt::NoPen);
+        }
+        style.brush = QBrush(background->background_color);
+        style.radius = background->rounded;
+        style.opaque = background->background_color.alpha() == 255
+                && (!background->border_color.alpha() || background->border_color.alpha() == 255);
+        styles.push_back(std::move(style));
+    }
+}
+
+const struct render_style &renderStyle(int background_id)
+{
+    return styles.at(background_id);
+}
+
+/*
+ * Opaque axis-aligned rectangles do not need antialiasing; filling whole device pixels gives
+ * crisp edges and is much cheaper than stroking a half-pixel-offset outline.
+ */
+static void draw_snapped(QPainter *painter, const QRectF &rect, const struct render_style &style,
+                         const QPen &pen)
+{
+    qreal half = pen.style() == Qt::NoPen ? 0 : pen.widthF() / 2;
+    QRect outer = rect.adjusted(-half, -half, half, half).toAlignedRect();
+    bool antialiasing = painter->testRenderHint(QPainter::Antialiasing);
+    painter->setRenderHint(QPainter::Antialiasing, false);
+    painter->fillRect(outer, style.brush);
+    if (pen.style() != Qt::NoPen) {
+        int w = std::max(1, (int)std::lround(pen.widthF()));
+        QBrush border = pen.brush();
+        painter->fillRect(QRect(outer.left(), outer.top(), outer.width(), w), border);
+        painter->fillRect(QRect(outer.left(), outer.bottom() - w + 1, outer.width(), w), border);
+        painter->fillRect(QRect(outer.left(), outer.top() + w, w, outer.height() - 2 * w), border);
+        painter->fillRect(QRect(outer.right() - w + 1, outer.top() + w, w, outer.height() - 2 * w),
+                          border);
+    }
+    painter->setRenderHint(QPainter::Antialiasing, antialiasing);
+}
+
+static const QPainterPath &rounded_path(const struct render_style &style, const QSizeF &size)
+{
+    for (auto &[cached, path] : style.paths) {
+        if (cached == size)
+            return path;
+    }
+    if (style.paths.size() >= MAX_PATHS)
+        style.paths.erase(style.paths.begin());
+    QPainterPath path;
+    path.addRoundedRect(QRectF(QPointF(0, 0), size), style.radius, style.radius);
+    style.paths.emplace_back(size, std::move(path));
+    return style.paths.back().second;
+}
+
+void renderStyleDrawRect(QPainter *painter, const QRectF &rect, const struct render_style &style)
+{
+    if (style.opaque) {
+        draw_snapped(painter, rect, style, style.pen);
+        return;
+    }
+    painter->setPen(style.pen);
+    painter->setBrush(style.brush);
+    painter->drawRect(rect);
+}
+
+void renderStyleDrawShape(QPainter *painter, const QRectF &rect, const struct render_style &style,
+                          const QPen *pen)
+{
+    const QPen &border = pen ? *pen : style.pen;
+    bool opaque = style.opaque && (!pen || border.color().alpha() == 255);
+    if (!style.radius && opaque) {
+        draw_snapped(painter, rect, style, border);
+        return;
+    }
+    painter->setPen(border);
+    painter->setBrush(style.brush);
+    if (!style.radius) {
+        painter->drawRect(rect);
+        return;
+    }
+    painter->translate(rect.topLeft());
+    painter->drawPath(rounded_path(style, rect.size()));
+    painter->translate(-rect.topLeft());
+}
+
+QRect renderStyleOpaqueRect(const struct render_style &style, const QRect &bounds)
+{
+    if (style.brush.color().alpha() != 255)
+        return QRect();
+    if (style.pen.style() == Qt::NoPen || style.pen.color().alpha() == 255)
+        return bounds;
+    // A translucent border lets through what is below it
+    int width = std::ceil(style.pen.widthF());
+    return bounds.adjusted(width, width, -width, -width);
+}
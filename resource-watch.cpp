@@ -0,0 +1,197 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <QCoreApplication>
+#include <QThreadPool>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include "conf.h"
+#include "icon-cache.h"
+#include "log.h"
+#include "resource-watch.h"
+
+static constexpr uint32_t WATCH_MASK = IN_CREATE | IN_DELETE | IN_CLOSE_WRITE | IN_MOVED_FROM
+        | IN_MOVED_TO | IN_ONLYDIR;
+
+ResourceWatcher::ResourceWatcher(struct sfdo *sfdo) : m_sfdo{ sfdo }, m_notifier{ nullptr }
+{
+    m_changes.icon_theme = false;
+    m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_fd < 0) {
+        warn("inotify_init1(): {}", strerror(errno));
+        return;
+    }
+
+    addWatches();
+
+    m_notifier = new QSocketNotifier(m_fd, QSocketNotifier::Read);
+    QObject::connect(m_notifier, &QSocketNotifier::activated, [this]() { readEvents(); });
+
+    // Package managers touch many files in a row; apply them in one go
+    m_debounce.setSingleShot(true);
+    m_debounce.setInterval(500);
+    m_pool.setMaxThreadCount(1);
+    QObject::connect(&m_debounce, &QTimer::timeout, [this]() { apply(); });
+}
+
+ResourceWatcher::~ResourceWatcher()
+{
+    m_pool.waitForDone();
+    delete m_notifier;
+    if (m_fd >= 0)
+        close(m_fd);
+}
+
+void ResourceWatcher::addWatches(void)
+{
+    /*
+     * Directories which do not exist yet are not watched; creating one (as opposed to adding
+     * files to an existing one) is picked up on the next start through the icon index.
+     */
+    std::string home = getenv("HOME") ? getenv("HOME") : "";
+    std::vector<std::string> icon_dirs = { home + "/.icons" };
+    for (auto &dir : xdgDataDirs()) {
+        addWatchRecursive(WATCH_APPLICATIONS, dir + "/applications", "");
+        icon_dirs.push_back(dir + "/icons");
+    }
+    for (auto &dir : icon_dirs) {
+        addWatchRecursive(WATCH_ICONS, dir + "/" + m_sfdo->theme, "");
+        if (m_sfdo->theme != "hicolor")
+            addWatchRecursive(WATCH_ICONS, dir + "/hicolor", "");
+    }
+    addWatch(WATCH_ICONS, "/usr/share/pixmaps", "");
+}
+
+void ResourceWatcher::addWatch(enum watch_kind kind, const std::string &path,
+                               const std::string &relpath)
+{
+    int wd = inotify_add_watch(m_fd, path.c_str(), WATCH_MASK);
+    if (wd < 0)
+        return;
+    m_watches[wd] = { .kind = kind, .path = path, .relpath = relpath };
+}
+
+void ResourceWatcher::addWatchRecursive(enum watch_kind kind, const std::string &path,
+                                        const std::string &relpath)
+{
+    std::error_code ec;
+    if (!std::filesystem::is_directory(path, ec))
+        return;
+    addWatch(kind, path, relpath);
+    for (auto &entry : std::filesystem::directory_iterator(path, ec)) {
+        if (entry.is_directory(ec)) {
+            std::string name = entry.path().filename();
+            addWatchRecursive(kind, entry.path(), relpath + name + "/");
+        }
+    }
+}
+
+void ResourceWatcher::readEvents(void)
+{
+    alignas(struct inotify_event) char buf[4096];
+    ssize_t len;
+    bool overflow = false;
+    while ((len = read(m_fd, buf, sizeof(buf))) > 0) {
+        for (char *p = buf; p < buf + len;) {
+            auto event = reinterpret_cast<struct inotify_event *>(p);
+            p += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                overflow = true;
+                continue;
+            }
+            auto it = m_watches.find(event->wd);
+            if (it == m_watches.end())
+                continue;
+            if (event->mask & IN_IGNORED) {
+                m_watches.erase(it);
+                continue;
+            }
+            if (!event->len)
+                continue;
+            struct watch watch = it->second;
+            std::string name = event->name;
+            std::string path = watch.path + "/" + name;
+
+            if (event->mask & IN_ISDIR) {
+                if (event->mask & (IN_CREATE | IN_MOVED_TO))
+                    addWatchRecursive(watch.kind, path, watch.relpath + name + "/");
+                if (watch.kind == WATCH_ICONS)
+                    m_changes.icon_theme = true;
+                continue;
+            }
+
+            m_changes.files.insert(path);
+            if (watch.kind == WATCH_ICONS)
+                m_changes.icon_theme = true;
+            else
+                addDesktopFile(watch, name);
+        }
+    }
+    if (overflow)
+        rescan();
+    m_debounce.start();
+}
+
+void ResourceWatcher::addDesktopFile(const struct watch &watch, const std::string &name)
+{
+    if (!name.ends_with(".desktop"))
+        return;
+    // Desktop IDs replace '/' in the path below applications/ with '-'
+    std::string relpath = watch.relpath + name;
+    std::string desktop_id = relpath.substr(0, relpath.size() - strlen(".desktop"));
+    std::ranges::replace(desktop_id, '/', '-');
+    m_changes.desktop_files.emplace_back(desktop_id, relpath);
+}
+
+/*
+ * Events were lost: watches may be missing for new directories and stale for removed ones, and
+ * any resource may have changed, so everything is treated as changed.
+ */
+void ResourceWatcher::rescan(void)
+{
+    warn("inotify queue overflowed; rescanning desktop files and icons");
+    std::erase_if(m_watches, [this](const auto &item) {
+        std::error_code ec;
+        if (std::filesystem::is_directory(item.second.path, ec))
+            return false;
+        inotify_rm_watch(m_fd, item.first);
+        return true;
+    });
+    addWatches();
+
+    m_changes.icon_theme = true;
+    for (auto &[wd, watch] : m_watches) {
+        if (watch.kind != WATCH_APPLICATIONS)
+            continue;
+        std::error_code ec;
+        for (auto &entry : std::filesystem::directory_iterator(watch.path, ec)) {
+            if (!entry.is_directory(ec))
+                addDesktopFile(watch, entry.path().filename());
+        }
+    }
+}
+
+void ResourceWatcher::apply(void)
+{
+    struct resource_changes changes = std::move(m_changes);
+    m_changes = {};
+
+    if (conf.verbosity)
+        info("{} desktop files changed; icon theme {}", changes.desktop_files.size(),
+             changes.icon_theme ? "changed" : "unchanged");
+
+    std::vector<struct icon_lookup> lookups = iconCacheLookups();
+    struct sfdo *sfdo = m_sfdo;
+    m_pool.start([=]() {
+        auto affected = desktopEntryReload(sfdo, changes, lookups);
+        QMetaObject::invokeMethod(
+                qApp,
+                [=]() {
+                    if (!affected.empty())
+                        iconCacheInvalidate(affected);
+                },
+                Qt::QueuedConnection);
+    });
+}
@@ -1,10 +1,25 @@
 // SPDX-License-Identifier: GPL-2.0-only
 #include <cstring>
 #include <cmath>
+#include <format>
+#include <future>
+#include <mutex>
+#include <ranges>
+#include <unistd.h>
+#include <QCoreApplication>
 #include <QIcon>
 #include "conf.h"
+#include "desktop-index.h"
+#include "icon-index.h"
 #include "log.h"
 #include "resources.h"
+#include "startup-report.h"
+
+/* libsfdo is not thread-safe and icons are resolved on worker threads */
+static std::mutex sfdo_mutex;
+
+static constexpr int THEME_LOAD_OPTIONS = SFDO_ICON_THEME_LOAD_OPTIONS_DEFAULT
+        | SFDO_ICON_THEME_LOAD_OPTION_ALLOW_MISSING | SFDO_ICON_THEME_LOAD_OPTION_RELAXED;
 
 static void log_handler(enum sfdo_log_level level, const char *fmt, va_list args, void *tag)
 {
@@ -21,40 +36,97 @@ static void log_handler(enum sfdo_log_level level, const char *fmt, va_list args
 
 void desktopEntryInit(struct sfdo *sfdo)
 {
-    struct sfdo_basedir_ctx *basedir_ctx = sfdo_basedir_ctx_create();
-    if (!basedir_ctx)
+    sfdo->loading = false;
+    sfdo->desktop_db = nullptr;
+    sfdo->desktop_index = nullptr;
+    sfdo->icon_theme = nullptr;
+    sfdo->theme = QIcon::themeName().toStdString();
+    info("use icon theme '{}'", sfdo->theme);
+    iconIndexInit(sfdo->theme);
+
+    sfdo->basedir_ctx = sfdo_basedir_ctx_create();
+    if (!sfdo->basedir_ctx)
         die("sfdo_basedir_ctx_create()");
-    sfdo->desktop_ctx = sfdo_desktop_ctx_create(basedir_ctx);
+    sfdo->desktop_ctx = sfdo_desktop_ctx_create(sfdo->basedir_ctx);
     if (!sfdo->desktop_ctx)
         die("sfdo_desktop_ctx_create()");
-    sfdo->icon_ctx = sfdo_icon_ctx_create(basedir_ctx);
+    sfdo->icon_ctx = sfdo_icon_ctx_create(sfdo->basedir_ctx);
     if (!sfdo->icon_ctx)
         die("sfdo_icon_ctx_create()");
     enum sfdo_log_level level = SFDO_LOG_LEVEL_ERROR;
     sfdo_desktop_ctx_set_log_handler(sfdo->desktop_ctx, level, log_handler, (void *)"libsfdo");
     sfdo_icon_ctx_set_log_handler(sfdo->icon_ctx, level, log_handler, (void *)"libsfdo");
-    char *locale = setlocale(LC_ALL, "");
-    sfdo->desktop_db = sfdo_desktop_db_load(sfdo->desktop_ctx, locale);
-    if (!sfdo->desktop_db)
-        die("sfdo_desktop_db_load()");
-    int load_options = SFDO_ICON_THEME_LOAD_OPTIONS_DEFAULT
-            | SFDO_ICON_THEME_LOAD_OPTION_ALLOW_MISSING | SFDO_ICON_THEME_LOAD_OPTION_RELAXED;
+}
 
-    std::string theme = QIcon::themeName().toStdString();
-    info("use icon theme '{}'", theme);
-    sfdo->icon_theme = sfdo_icon_theme_load(sfdo->icon_ctx, theme.data(), load_options);
+/* Loader threads must not exit the process under the other threads; tell the GUI thread */
+static void report_failure(std::string message)
+{
+    QMetaObject::invokeMethod(qApp, [message]() { warn("{}", message); }, Qt::QueuedConnection);
+}
 
-    if (!sfdo->icon_theme)
-        die("sfdo_icon_theme_load()");
-    sfdo_basedir_ctx_destroy(basedir_ctx);
+/*
+ * The desktop database and icon theme use separate contexts and are loaded concurrently on
+ * their own threads. Run once through sfdo->load_started.
+ */
+static void start_loading(struct sfdo *sfdo)
+{
+    sfdo->loading = true;
+
+    // setlocale() is not thread-safe, so resolve the locale before starting the threads
+    std::string locale = setlocale(LC_ALL, "");
+
+    sfdo->desktop_db_loading = std::async(std::launch::async, [sfdo, locale]() {
+        StartupPhase phase("desktop database");
+        sfdo->desktop_db = sfdo_desktop_db_load(sfdo->desktop_ctx, locale.c_str());
+        if (!sfdo->desktop_db) {
+            report_failure("cannot load desktop database; icons are looked up by app_id only");
+            return;
+        }
+        sfdo->desktop_index = desktopIndexCreate(sfdo->desktop_db);
+    });
+
+    sfdo->icon_theme_loading = std::async(std::launch::async, [sfdo]() {
+        StartupPhase phase("icon theme");
+        sfdo->icon_theme =
+                sfdo_icon_theme_load(sfdo->icon_ctx, sfdo->theme.data(), THEME_LOAD_OPTIONS);
+        if (!sfdo->icon_theme)
+            report_failure(std::format("cannot load icon theme '{}'", sfdo->theme));
+    });
+}
+
+/*
+ * Start loading if nobody has yet and block until it is done. sfdo_mutex must not be held, so
+ * that lookups answered by the icon index are not held up by the load.
+ */
+static void wait_loaded(struct sfdo *sfdo)
+{
+    std::call_once(sfdo->load_started, start_loading, sfdo);
+    std::call_once(sfdo->load_finished, [sfdo]() {
+        sfdo->desktop_db_loading.wait();
+        sfdo->icon_theme_loading.wait();
+    });
+}
+
+void desktopEntryLoadAsync(struct sfdo *sfdo)
+{
+    std::call_once(sfdo->load_started, start_loading, sfdo);
 }
 
 void desktopEntryFinish(struct sfdo *sfdo)
 {
-    sfdo_icon_theme_destroy(sfdo->icon_theme);
-    sfdo_desktop_db_destroy(sfdo->desktop_db);
+    if (sfdo->loading)
+        wait_loaded(sfdo);
+    std::lock_guard lock(sfdo_mutex);
+    iconIndexFinish();
+    if (sfdo->icon_theme)
+        sfdo_icon_theme_destroy(sfdo->icon_theme);
+    if (sfdo->desktop_index)
+        desktopIndexDestroy(sfdo->desktop_index);
+    if (sfdo->desktop_db)
+        sfdo_desktop_db_destroy(sfdo->desktop_db);
     sfdo_icon_ctx_destroy(sfdo->icon_ctx);
     sfdo_desktop_ctx_destroy(sfdo->desktop_ctx);
+    sfdo_basedir_ctx_destroy(sfdo->basedir_ctx);
 }
 
 /* Return the length of a filename minus any known extension */
@@ -74,6 +146,8 @@ static std::string process_rel_name(const char *icon_name, struct sfdo *sfdo, in
 {
     std::string iconpath;
     int lookup_options = SFDO_ICON_THEME_LOOKUP_OPTIONS_DEFAULT;
+    if (!sfdo->icon_theme)
+        return iconpath;
 
     /*
      * Relative icon names are not supposed to include an extension, but some .desktop files include
@@ -90,62 +164,6 @@ static std::string process_rel_name(const char *icon_name, struct sfdo *sfdo, in
     return iconpath;
 }
 
-static struct sfdo_desktop_entry *get_db_entry_by_id_fuzzy(struct sfdo_desktop_db *db,
-                                                           const char *app_id)
-{
-    size_t n_entries;
-    struct sfdo_desktop_entry **entries = sfdo_desktop_db_get_entries(db, &n_entries);
-
-    for (size_t i = 0; i < n_entries; i++) {
-        struct sfdo_desktop_entry *entry = entries[i];
-        const char *desktop_id = sfdo_desktop_entry_get_id(entry, NULL);
-        /* Get portion of desktop ID after last '.' */
-        const char *dot = strrchr(desktop_id, '.');
-        const char *desktop_id_base = dot ? (dot + 1) : desktop_id;
-
-        if (!strcasecmp(app_id, desktop_id_base)) {
-            return entry;
-        }
-
-        /* sfdo_desktop_entry_get_startup_wm_class() asserts against APPLICATION */
-        if (sfdo_desktop_entry_get_type(entry) != SFDO_DESKTOP_ENTRY_APPLICATION) {
-            continue;
-        }
-
-        /* Try desktop entry's StartupWMClass also */
-        const char *wm_class = sfdo_desktop_entry_get_startup_wm_class(entry, NULL);
-        if (wm_class && !strcasecmp(app_id, wm_class)) {
-            return entry;
-        }
-    }
-
-    /* Try matching partial strings - catches GIMP, among others */
-    for (size_t i = 0; i < n_entries; i++) {
-        struct sfdo_desktop_entry *entry = entries[i];
-        const char *desktop_id = sfdo_desktop_entry_get_id(entry, NULL);
-        const char *dot = strrchr(desktop_id, '.');
-        const char *desktop_id_base = dot ? (dot + 1) : desktop_id;
-        int alen = strlen(app_id);
-        int dlen = strlen(desktop_id_base);
-
-        if (!strncasecmp(app_id, desktop_id, alen > dlen ? dlen : alen)) {
-            return entry;
-        }
-    }
-
-    return NULL;
-}
-
-static struct sfdo_desktop_entry *get_desktop_entry(struct sfdo *sfdo, const char *app_id)
-{
-    struct sfdo_desktop_entry *entry =
-            sfdo_desktop_db_get_entry_by_id(sfdo->desktop_db, app_id, SFDO_NT);
-    if (!entry) {
-        entry = get_db_entry_by_id_fuzzy(sfdo->desktop_db, app_id);
-    }
-    return entry;
-}
-
 static std::string get_icon_path(struct sfdo *sfdo, const char *icon_name, int size, float scale)
 {
     std::string iconpath;
@@ -167,16 +185,14 @@ static std::string get_icon_path(struct sfdo *sfdo, const char *icon_name, int s
     return iconpath;
 }
 
-std::string load_icon_from_app_id(struct sfdo *sfdo, const char *app_id, int size, float scale)
+/* Callers must have waited for loading to finish and must hold sfdo_mutex */
+static std::string resolve_icon(struct sfdo *sfdo, const char *app_id, int size, float scale)
 {
     std::string iconpath;
+    std::string icon_name;
 
-    if (!app_id || !*app_id)
-        return iconpath;
-
-    struct sfdo_desktop_entry *entry = get_desktop_entry(sfdo, app_id);
-    const char *icon_name = entry ? sfdo_desktop_entry_get_icon(entry, NULL) : NULL;
-    iconpath = get_icon_path(sfdo, icon_name, size, scale);
+    if (sfdo->desktop_index && desktopIndexLookup(sfdo->desktop_index, app_id, &icon_name))
+        iconpath = get_icon_path(sfdo, icon_name.c_str(), size, scale);
 
     /*
      * Fallback on using the app_id if 'Icon' is not defined in .desktop file or the icon could not
@@ -185,6 +201,131 @@ std::string load_icon_from_app_id(struct sfdo *sfdo, const char *app_id, int siz
     if (iconpath.empty()) {
         iconpath = get_icon_path(sfdo, app_id, size, scale);
     }
+    return iconpath;
+}
+
+std::string load_icon_from_app_id(struct sfdo *sfdo, const char *app_id, int size, float scale)
+{
+    std::string iconpath;
+
+    if (!app_id || !*app_id)
+        return iconpath;
+
+    {
+        std::lock_guard lock(sfdo_mutex);
+        if (iconIndexLookup(app_id, size, scale, &iconpath))
+            return iconpath;
+    }
+
+    wait_loaded(sfdo);
+    std::lock_guard lock(sfdo_mutex);
+    iconpath = resolve_icon(sfdo, app_id, size, scale);
 
+    // Remember misses as well, so that icon-less apps do not trigger a load on every start
+    iconIndexInsert(app_id, size, scale, iconpath);
     return iconpath;
 }
+
+/*
+ * The first existing <data dir>/applications/@relpath in order of precedence, and the position
+ * of its data dir
+ */
+static std::string find_desktop_file(const std::string &relpath, int *precedence)
+{
+    std::vector<std::string> dirs = xdgDataDirs();
+    for (size_t i = 0; i < dirs.size(); i++) {
+        std::string path = dirs[i] + "/applications/" + relpath;
+        if (!access(path.c_str(), R_OK)) {
+            *precedence = i;
+            return path;
+        }
+    }
+    *precedence = dirs.size();
+    return "";
+}
+
+std::unordered_set<std::string> desktopEntryReload(struct sfdo *sfdo,
+                                                  const struct resource_changes &changes,
+                                                  const std::vector<struct icon_lookup> &lookups)
+{
+    std::unordered_set<std::string> affected;
+    wait_loaded(sfdo);
+
+    /*
+     * Loading a theme takes long, so it is done without holding up the icon workers: into a
+     * context of its own, which replaces the old one together with the theme.
+     */
+    struct sfdo_icon_ctx *icon_ctx = nullptr;
+    struct sfdo_icon_theme *icon_theme = nullptr;
+    if (changes.icon_theme) {
+        info("reload icon theme '{}'", sfdo->theme);
+        icon_ctx = sfdo_icon_ctx_create(sfdo->basedir_ctx);
+        if (icon_ctx) {
+            sfdo_icon_ctx_set_log_handler(icon_ctx, SFDO_LOG_LEVEL_ERROR, log_handler,
+                                          (void *)"libsfdo");
+            icon_theme = sfdo_icon_theme_load(icon_ctx, sfdo->theme.data(), THEME_LOAD_OPTIONS);
+        }
+        if (!icon_theme) {
+            warn("cannot reload icon theme '{}'", sfdo->theme);
+            if (icon_ctx)
+                sfdo_icon_ctx_destroy(icon_ctx);
+        }
+    }
+
+    std::lock_guard lock(sfdo_mutex);
+
+    std::vector<std::string> old_paths;
+    for (auto &lookup : lookups) {
+        std::string iconpath;
+        iconIndexLookup(lookup.app_id.c_str(), lookup.size, lookup.scale, &iconpath);
+        old_paths.push_back(std::move(iconpath));
+    }
+
+    if (sfdo->desktop_index) {
+        for (auto &[desktop_id, relpath] : changes.desktop_files) {
+            int precedence;
+            std::string path = find_desktop_file(relpath, &precedence);
+            desktopIndexReload(sfdo->desktop_index, desktop_id, path, precedence);
+        }
+    }
+    if (icon_theme) {
+        if (sfdo->icon_theme)
+            sfdo_icon_theme_destroy(sfdo->icon_theme);
+        sfdo_icon_ctx_destroy(sfdo->icon_ctx);
+        sfdo->icon_theme = icon_theme;
+        sfdo->icon_ctx = icon_ctx;
+    }
+
+    // Everything resolved before the change is suspect from now on
+    iconIndexRevalidate();
+
+    for (size_t i = 0; i < lookups.size(); i++) {
+        auto &lookup = lookups[i];
+        std::string iconpath =
+                resolve_icon(sfdo, lookup.app_id.c_str(), lookup.size, lookup.scale);
+        iconIndexInsert(lookup.app_id.c_str(), lookup.size, lookup.scale, iconpath);
+        if (iconpath != old_paths[i] || changes.files.contains(iconpath))
+            affected.insert(lookup.app_id);
+    }
+    return affected;
+}
+
+std::vector<std::string> xdgDataDirs(void)
+{
+    const char *home = getenv("HOME");
+    const char *data_home = getenv("XDG_DATA_HOME");
+    const char *data_dirs = getenv("XDG_DATA_DIRS");
+
+    std::vector<std::string> dirs;
+    if (data_home && *data_home)
+        dirs.push_back(data_home);
+    else
+        dirs.push_back(std::string(home ? home : "") + "/.local/share");
+
+    std::string system_dirs = data_dirs && *data_dirs ? data_dirs : "/usr/local/share:/usr/share";
+    for (auto part : system_dirs | std::views::split(':')) {
+        if (!part.empty())
+            dirs.emplace_back(part.begin(), part.end());
+    }
+    return dirs;
+}
@@ -0,0 +1,56 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <atomic>
+#include <mutex>
+#include <print>
+#include "startup-report.h"
+
+using std::chrono::steady_clock;
+
+static std::atomic<bool> enabled;
+static steady_clock::time_point process_start = steady_clock::now();
+static std::mutex print_mutex;
+
+static double ms_since(steady_clock::time_point start, steady_clock::time_point end)
+{
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+static void report(const char *name, steady_clock::time_point start, steady_clock::time_point end)
+{
+    std::lock_guard lock(print_mutex);
+    std::println(stderr, "startup: {:<20} {:8.2f} ms  (+{:.2f} ms .. +{:.2f} ms)", name,
+                 ms_since(start, end), ms_since(process_start, start),
+                 ms_since(process_start, end));
+}
+
+void startupReportEnable(void)
+{
+    enabled = true;
+}
+
+/* Report a point in time, such as the first frame, measured from process start */
+void startupReportMark(const char *name)
+{
+    if (enabled)
+        report(name, process_start, steady_clock::now());
+}
+
+StartupPhase::StartupPhase(const char *name) : m_name{ name }
+{
+    if (enabled)
+        m_start = steady_clock::now();
+}
+
+StartupPhase::~StartupPhase()
+{
+    end();
+}
+
+void StartupPhase::end(void)
+{
+    if (!m_name)
+        return;
+    if (enabled)
+        report(m_name, m_start, steady_clock::now());
+    m_name = nullptr;
+}
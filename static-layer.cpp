@@ -0,0 +1,36 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <cmath>
+#include "conf.h"
+#include "static-layer.h"
+
+static uint64_t render_count;
+
+StaticLayer::StaticLayer() : m_dpr{ 0 }, m_generation{ 0 } { }
+
+void StaticLayer::draw(QPainter *painter, const QRectF &rect, const render_fn &render)
+{
+    qreal dpr = painter->device()->devicePixelRatioF();
+    if (m_pixmap.isNull() || rect != m_rect || dpr != m_dpr || conf.generation != m_generation) {
+        m_rect = rect;
+        m_dpr = dpr;
+        m_generation = conf.generation;
+
+        QSize size(std::ceil(rect.width() * dpr), std::ceil(rect.height() * dpr));
+        m_pixmap = QPixmap(size);
+        m_pixmap.setDevicePixelRatio(dpr);
+        m_pixmap.fill(Qt::transparent);
+
+        QPainter layer(&m_pixmap);
+        layer.setRenderHint(QPainter::Antialiasing);
+        layer.translate(-rect.topLeft());
+        render(&layer);
+        layer.end();
+        ++render_count;
+    }
+    painter->drawPixmap(rect.topLeft(), m_pixmap);
+}
+
+uint64_t staticLayerCount(void)
+{
+    return render_count;
+}
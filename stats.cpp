@@ -0,0 +1,215 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "frame-scheduler.h"
+#include "icon-cache.h"
+#include "item-type.h"
+#include "log.h"
+#include "stats.h"
+#include "text-layout.h"
+#include "tick-scheduler.h"
+
+// Bucket i counts paints shorter than 2^i microseconds; the last one is open-ended
+static constexpr int PAINT_BUCKETS = 16;
+static constexpr int PAINT_TYPES = PANEL_TYPE_CLOCK + 1;
+
+struct paint_histogram {
+    uint64_t count;
+    std::chrono::nanoseconds total;
+    uint64_t buckets[PAINT_BUCKETS];
+};
+
+std::atomic<bool> stats_collecting;
+
+static struct paint_histogram paint_times[PAINT_TYPES];
+static std::atomic<uint64_t> wayland_events[STATS_LISTENER_COUNT];
+static std::chrono::steady_clock::time_point collecting_since;
+
+// Indexed by PANEL_TYPE_* and stats_listener
+static const char *const paint_type_names[PAINT_TYPES] = {
+    nullptr, "background", "task", "taskbar", "clock",
+};
+static const char *const listener_names[STATS_LISTENER_COUNT] = {
+    "registry", "toplevel_manager", "toplevel",
+};
+
+void statsAddWaylandEvent(enum stats_listener listener)
+{
+    wayland_events[listener].fetch_add(1, std::memory_order_relaxed);
+}
+
+void statsAddPaint(int type, std::chrono::steady_clock::duration time)
+{
+    if (type <= 0 || type >= PAINT_TYPES)
+        return;
+    struct paint_histogram &histogram = paint_times[type];
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(time).count();
+    int bucket = 0;
+    while (bucket < PAINT_BUCKETS - 1 && us >= (1 << bucket))
+        bucket++;
+    histogram.count++;
+    histogram.total += time;
+    histogram.buckets[bucket]++;
+}
+
+static void reset(void)
+{
+    for (auto &histogram : paint_times)
+        histogram = {};
+    for (auto &count : wayland_events)
+        count = 0;
+    collecting_since = std::chrono::steady_clock::now();
+}
+
+static double hit_rate(uint64_t hits, uint64_t misses)
+{
+    return hits + misses ? (double)hits / (hits + misses) : 0;
+}
+
+static std::string snapshot(void)
+{
+    auto elapsed = std::chrono::steady_clock::now() - collecting_since;
+    std::string out = std::format(
+            "{{\"collecting_ms\":{},",
+            std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count());
+
+    out += "\"paint\":{";
+    for (int type = 1; type < PAINT_TYPES; type++) {
+        const struct paint_histogram &histogram = paint_times[type];
+        out += std::format("{}\"{}\":{{\"count\":{},\"total_us\":{},\"histogram_us\":{{",
+                           type > 1 ? "," : "", paint_type_names[type], histogram.count,
+                           histogram.total.count() / 1000);
+        for (int i = 0; i < PAINT_BUCKETS; i++) {
+            if (i < PAINT_BUCKETS - 1)
+                out += std::format("{}\"{}\":{}", i ? "," : "", 1 << i, histogram.buckets[i]);
+            else
+                out += std::format(",\"+Inf\":{}", histogram.buckets[i]);
+        }
+        out += "}}";
+    }
+
+    out += std::format("}},\"timer_wakeups\":{{\"total\":{}", tickWakeups());
+    for (auto &[name, count] : tickSourceWakeups())
+        out += std::format(",\"{}\":{}", name, count);
+
+    out += "},\"wayland_events\":{";
+    for (int i = 0; i < STATS_LISTENER_COUNT; i++)
+        out += std::format("{}\"{}\":{}", i ? "," : "", listener_names[i],
+                           wayland_events[i].load(std::memory_order_relaxed));
+
+    struct icon_cache_stats icons = iconCacheStats();
+    struct text_layout_stats text = textLayoutStats();
+    out += std::format("}},\"frames\":{{\"committed\":{},\"coalesced\":{}}}", frameCommittedCount(),
+                       frameCoalescedCount());
+    out += std::format(",\"icon_cache\":{{\"hits\":{},\"misses\":{},\"hit_rate\":{:.3f},"
+                       "\"bytes\":{}}}",
+                       icons.hits, icons.misses, hit_rate(icons.hits, icons.misses), icons.bytes);
+    out += std::format(",\"text_layout\":{{\"hits\":{},\"misses\":{},\"hit_rate\":{:.3f}}}}}\n",
+                       text.hits, text.misses, hit_rate(text.hits, text.misses));
+    return out;
+}
+
+StatsServer::StatsServer() : m_fd{ -1 }
+{
+    const char *runtime_dir = getenv("XDG_RUNTIME_DIR");
+    if (!runtime_dir) {
+        warn("XDG_RUNTIME_DIR is not set; not serving stats");
+        return;
+    }
+    m_path = std::format("{}/tint-stats-{}.sock", runtime_dir, getpid());
+
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (m_path.size() >= sizeof(addr.sun_path)) {
+        warn("stats socket path '{}' is too long", m_path);
+        return;
+    }
+    memcpy(addr.sun_path, m_path.c_str(), m_path.size() + 1);
+
+    m_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (m_fd < 0) {
+        warn("socket(): {}", strerror(errno));
+        return;
+    }
+    unlink(m_path.c_str());
+    if (bind(m_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(m_fd, 4) < 0) {
+        warn("cannot listen on '{}': {}", m_path, strerror(errno));
+        close(m_fd);
+        m_fd = -1;
+        return;
+    }
+
+    auto notifier = new QSocketNotifier(m_fd, QSocketNotifier::Read, this);
+    connect(notifier, &QSocketNotifier::activated, this, &StatsServer::accept);
+    info("serve stats on '{}'", m_path);
+}
+
+StatsServer::~StatsServer()
+{
+    while (!m_clients.empty())
+        drop(m_clients.begin()->first);
+    if (m_fd >= 0) {
+        close(m_fd);
+        unlink(m_path.c_str());
+    }
+}
+
+void StatsServer::accept(void)
+{
+    int fd = accept4(m_fd, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+    if (fd < 0) {
+        if (errno != EAGAIN)
+            warn("accept4(): {}", strerror(errno));
+        return;
+    }
+    if (m_clients.empty()) {
+        reset();
+        stats_collecting = true;
+    }
+    auto notifier = new QSocketNotifier(fd, QSocketNotifier::Read, this);
+    connect(notifier, &QSocketNotifier::activated, this, [this, fd]() { read(fd); });
+    m_clients[fd] = notifier;
+}
+
+/*
+ * Every line is a request, whatever it contains. Only the newlines are counted, so a request
+ * split across reads is answered once and several requests in one read are each answered.
+ */
+void StatsServer::read(int fd)
+{
+    char buf[256];
+    ssize_t len = recv(fd, buf, sizeof(buf), 0);
+    if (len < 0 && errno == EAGAIN)
+        return;
+    if (len <= 0) {
+        drop(fd);
+        return;
+    }
+
+    // A snapshot is far smaller than a socket buffer; a client which lets it fill up is dropped
+    for (auto lines = std::count(buf, buf + len, '\n'); lines > 0; lines--) {
+        std::string out = snapshot();
+        if (send(fd, out.data(), out.size(), MSG_NOSIGNAL) != (ssize_t)out.size()) {
+            drop(fd);
+            return;
+        }
+    }
+}
+
+void StatsServer::drop(int fd)
+{
+    // May be called from the notifier's own signal
+    QSocketNotifier *notifier = m_clients[fd];
+    notifier->setEnabled(false);
+    notifier->deleteLater();
+    m_clients.erase(fd);
+    close(fd);
+    if (m_clients.empty())
+        stats_collecting = false;
+}
@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Matching of app_ids against a desktop database made of a few fixtures, written to a temporary
+ * directory which replaces the XDG data directories.
+ */
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <print>
+#include <string>
+#include <sfdo-basedir.h>
+#include <sfdo-desktop.h>
+#include "desktop-index.h"
+
+static int failures;
+
+static void write_desktop_file(const std::filesystem::path &path, const char *icon,
+                               const char *wm_class = nullptr)
+{
+    std::ofstream file(path);
+    std::print(file, "[Desktop Entry]\nType=Application\nName={}\nExec=true\nIcon={}\n",
+               path.stem().string(), icon);
+    if (wm_class)
+        std::print(file, "StartupWMClass={}\n", wm_class);
+}
+
+/* @expected is the Icon of the entry which should match, or nullptr for no match */
+static void expect(struct desktop_index *index, const char *app_id, const char *expected)
+{
+    std::string icon;
+    bool found = desktopIndexLookup(index, app_id, &icon);
+    if (found == (expected != nullptr) && (!found || icon == expected))
+        return;
+    std::println(stderr, "'{}': expected {}, got {}", app_id, expected ? expected : "no match",
+                 found ? icon : "no match");
+    failures++;
+}
+
+int main(void)
+{
+    char pattern[] = "/tmp/tint-test-XXXXXX";
+    if (!mkdtemp(pattern)) {
+        std::println(stderr, "mkdtemp() failed");
+        return 1;
+    }
+    std::filesystem::path root = pattern;
+    std::filesystem::create_directories(root / "applications");
+    write_desktop_file(root / "applications/org.kde.kate.desktop", "kate");
+    write_desktop_file(root / "applications/org.gimp.GIMP.desktop", "gimp");
+    write_desktop_file(root / "applications/org.mozilla.firefox.desktop", "firefox");
+    write_desktop_file(root / "applications/editor.desktop", "editor", "Scribbler");
+    setenv("XDG_DATA_HOME", root.c_str(), 1);
+    setenv("XDG_DATA_DIRS", root.c_str(), 1);
+
+    struct sfdo_basedir_ctx *basedir_ctx = sfdo_basedir_ctx_create();
+    struct sfdo_desktop_ctx *desktop_ctx = sfdo_desktop_ctx_create(basedir_ctx);
+    struct sfdo_desktop_db *db = sfdo_desktop_db_load(desktop_ctx, NULL);
+    if (!db) {
+        std::println(stderr, "sfdo_desktop_db_load() failed");
+        return 1;
+    }
+    struct desktop_index *index = desktopIndexCreate(db);
+
+    // Desktop ID, then basename and StartupWMClass regardless of case
+    expect(index, "org.kde.kate", "kate");
+    expect(index, "Kate", "kate");
+    expect(index, "SCRIBBLER", "editor");
+
+    // Partial matches: the basename is a prefix of the app_id, or the other way around
+    expect(index, "gimp-2.10", "gimp");
+    expect(index, "firef", "firefox");
+
+    // The partial match used to compare against the whole desktop ID, so any reverse-DNS
+    // app_id sharing its first few characters with one matched
+    expect(index, "org.example.Unknown", nullptr);
+    expect(index, "org.", nullptr);
+    expect(index, "unknown", nullptr);
+    // Again, now from the negative cache
+    expect(index, "org.example.Unknown", nullptr);
+
+    // A re-read desktop file takes precedence over the database
+    write_desktop_file(root / "kate.desktop", "kate-new");
+    desktopIndexReload(index, "org.kde.kate", (root / "kate.desktop").string(), 0);
+    expect(index, "org.kde.kate", "kate-new");
+    expect(index, "kate", "kate-new");
+    desktopIndexReload(index, "org.kde.kate", "", 0);
+    expect(index, "org.kde.kate", nullptr);
+
+    // Of two re-read entries for the same app, the one in the more important data dir wins
+    write_desktop_file(root / "a.desktop", "viewer-system");
+    write_desktop_file(root / "b.desktop", "viewer-user");
+    desktopIndexReload(index, "org.a.Viewer", (root / "a.desktop").string(), 1);
+    desktopIndexReload(index, "org.b.Viewer", (root / "b.desktop").string(), 0);
+    expect(index, "viewer", "viewer-user");
+
+    desktopIndexDestroy(index);
+    sfdo_desktop_db_destroy(db);
+    sfdo_desktop_ctx_destroy(desktop_ctx);
+    sfdo_basedir_ctx_destroy(basedir_ctx);
+    std::filesystem::remove_all(root);
+    return failures ? 1 : 0;
+}
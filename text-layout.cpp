@@ -0,0 +1,42 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <QFontMetricsF>
+#include "text-layout.h"
+
+static uint64_t layout_count;
+static uint64_t lookup_count;
+
+TextLayout::TextLayout() : m_width{ -1 }, m_mode{ Qt::ElideRight }, m_valid{ false }
+{
+    m_staticText.setTextFormat(Qt::PlainText);
+    m_staticText.setPerformanceHint(QStaticText::AggressiveCaching);
+}
+
+const QStaticText &TextLayout::layout(const QString &text, const QFont &font, qreal width,
+                                      Qt::TextElideMode mode)
+{
+    ++lookup_count;
+    if (m_valid && width == m_width && mode == m_mode && text == m_text && font == m_font)
+        return m_staticText;
+
+    m_text = text;
+    m_font = font;
+    m_width = width;
+    m_mode = mode;
+    m_valid = true;
+
+    QFontMetricsF metrics(font);
+    m_staticText.setText(metrics.elidedText(text, mode, width));
+    m_staticText.prepare(QTransform(), font);
+    ++layout_count;
+    return m_staticText;
+}
+
+uint64_t textLayoutCount(void)
+{
+    return layout_count;
+}
+
+struct text_layout_stats textLayoutStats(void)
+{
+    return { .hits = lookup_count - layout_count, .misses = layout_count };
+}
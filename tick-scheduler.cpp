@@ -0,0 +1,171 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+#include <QSocketNotifier>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include "log.h"
+#include "tick-scheduler.h"
+
+struct tick_scheduler {
+    int fd = -1;
+    QSocketNotifier *notifier = nullptr;
+    std::vector<TickSource *> sources;
+    std::map<std::string, uint64_t> source_wakeups;
+    uint64_t wakeups = 0;
+    std::unordered_map<void *, bool> visible;
+    bool paused = false;
+
+    bool active(const TickSource *source) const
+    {
+        return source->m_scheduled && (source->m_essential || !paused);
+    }
+    void arm(void);
+    void dispatch(void);
+    void updatePaused(void);
+};
+
+static struct tick_scheduler scheduler;
+
+/* Sleep until the first moment by which one of the sources must have run */
+void tick_scheduler::arm(void)
+{
+    std::optional<std::chrono::system_clock::time_point> wake;
+    for (const TickSource *source : sources) {
+        if (!active(source))
+            continue;
+        auto latest = source->m_deadline + source->m_tolerance;
+        if (!wake || latest < *wake)
+            wake = latest;
+    }
+
+    // An all-zero expiry disarms the timer
+    struct itimerspec spec = {};
+    if (wake) {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(wake->time_since_epoch());
+        spec.it_value.tv_sec = ns.count() / 1000000000;
+        spec.it_value.tv_nsec = ns.count() % 1000000000;
+        if (!spec.it_value.tv_sec && !spec.it_value.tv_nsec)
+            spec.it_value.tv_nsec = 1;
+    }
+    if (timerfd_settime(fd, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET, &spec, nullptr) < 0)
+        warn("timerfd_settime(): {}", strerror(errno));
+}
+
+void tick_scheduler::dispatch(void)
+{
+    uint64_t expirations;
+    bool clock_set = false;
+    if (read(fd, &expirations, sizeof(expirations)) < 0) {
+        if (errno != ECANCELED) {
+            if (errno != EAGAIN)
+                warn("read(): {}", strerror(errno));
+            return;
+        }
+        clock_set = true;
+    }
+    ++wakeups;
+
+    // Callbacks may add, remove and reschedule sources
+    auto now = std::chrono::system_clock::now();
+    std::vector<TickSource *> due;
+    for (TickSource *source : sources) {
+        if (active(source) && (clock_set || source->m_deadline <= now)) {
+            source->m_scheduled = false;
+            due.push_back(source);
+        }
+    }
+    for (TickSource *source : due) {
+        if (!std::ranges::contains(sources, source) || source->m_scheduled)
+            continue;
+        ++*source->m_wakeups;
+        source->m_callback();
+    }
+    // The last source may have gone away in its callback
+    if (fd >= 0)
+        arm();
+}
+
+void tick_scheduler::updatePaused(void)
+{
+    bool paused = !visible.empty()
+            && std::ranges::none_of(visible, [](const auto &entry) { return entry.second; });
+    if (paused == this->paused)
+        return;
+    this->paused = paused;
+    if (fd >= 0)
+        arm();
+}
+
+TickSource::TickSource(const char *name, std::chrono::milliseconds tolerance, bool essential,
+                       callback callback)
+    : m_tolerance{ tolerance }, m_essential{ essential }, m_callback{ std::move(callback) },
+      m_scheduled{ false }
+{
+    if (scheduler.fd < 0) {
+        scheduler.fd = timerfd_create(CLOCK_REALTIME, TFD_CLOEXEC | TFD_NONBLOCK);
+        if (scheduler.fd < 0)
+            die("timerfd_create(): {}", strerror(errno));
+        scheduler.notifier = new QSocketNotifier(scheduler.fd, QSocketNotifier::Read);
+        QObject::connect(scheduler.notifier, &QSocketNotifier::activated,
+                         []() { scheduler.dispatch(); });
+    }
+    m_wakeups = &scheduler.source_wakeups[name];
+    scheduler.sources.push_back(this);
+}
+
+TickSource::~TickSource()
+{
+    std::erase(scheduler.sources, this);
+    if (m_scheduled)
+        scheduler.arm();
+    if (scheduler.sources.empty()) {
+        // May be destroyed from a callback, inside the notifier's own signal
+        scheduler.notifier->setEnabled(false);
+        scheduler.notifier->deleteLater();
+        scheduler.notifier = nullptr;
+        close(scheduler.fd);
+        scheduler.fd = -1;
+    }
+}
+
+void TickSource::schedule(std::chrono::system_clock::time_point deadline)
+{
+    m_scheduled = true;
+    m_deadline = deadline;
+    scheduler.arm();
+}
+
+void TickSource::cancel(void)
+{
+    if (!m_scheduled)
+        return;
+    m_scheduled = false;
+    scheduler.arm();
+}
+
+void tickSetVisible(void *owner, bool visible)
+{
+    scheduler.visible[owner] = visible;
+    scheduler.updatePaused();
+}
+
+void tickForgetVisible(void *owner)
+{
+    scheduler.visible.erase(owner);
+    scheduler.updatePaused();
+}
+
+const std::map<std::string, uint64_t> &tickSourceWakeups(void)
+{
+    return scheduler.source_wakeups;
+}
+
+uint64_t tickWakeups(void)
+{
+    return scheduler.wakeups;
+}
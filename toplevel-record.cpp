@@ -0,0 +1,177 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <cstring>
+#include <iterator>
+#include "log.h"
+#include "toplevel-record.h"
+
+static constexpr char MAGIC[] = "TINTREC1";
+
+enum update_flags {
+    UPDATE_ADDED = (1 << 0),
+    UPDATE_CLOSED = (1 << 1),
+    UPDATE_TITLE = (1 << 2),
+    UPDATE_APP_ID = (1 << 3),
+    UPDATE_STATE = (1 << 4),
+};
+
+static void put_varint(std::string &out, uint64_t value)
+{
+    do {
+        uint8_t byte = value & 0x7f;
+        value >>= 7;
+        out.push_back(byte | (value ? 0x80 : 0));
+    } while (value);
+}
+
+static void put_string(std::string &out, const std::string &s)
+{
+    put_varint(out, s.size());
+    out.append(s);
+}
+
+ToplevelRecorder::ToplevelRecorder(const std::string &path)
+    : m_file(path, std::ios::binary | std::ios::trunc)
+{
+    if (!m_file)
+        die("cannot write recording '{}'", path);
+    m_file.write(MAGIC, strlen(MAGIC));
+    m_last = std::chrono::steady_clock::now();
+}
+
+void ToplevelRecorder::write(const std::vector<struct toplevel_update> &updates)
+{
+    auto now = std::chrono::steady_clock::now();
+    auto delta = std::chrono::duration_cast<std::chrono::microseconds>(now - m_last);
+    m_last = now;
+
+    auto put_outputs = [this](std::string &out, const std::vector<struct wl_output *> &outputs) {
+        put_varint(out, outputs.size());
+        for (auto output : outputs) {
+            auto [it, added] = m_outputs.emplace(output, m_outputs.size());
+            put_varint(out, it->second);
+        }
+    };
+
+    std::string out;
+    put_varint(out, delta.count());
+    put_varint(out, updates.size());
+    for (auto &update : updates) {
+        const struct task_pending &pending = update.pending;
+        uint8_t flags = (update.added ? UPDATE_ADDED : 0) | (update.closed ? UPDATE_CLOSED : 0)
+                | (pending.title ? UPDATE_TITLE : 0) | (pending.app_id ? UPDATE_APP_ID : 0)
+                | (pending.state ? UPDATE_STATE : 0);
+        put_varint(out, update.id);
+        out.push_back(flags);
+        if (pending.title)
+            put_string(out, *pending.title);
+        if (pending.app_id)
+            put_string(out, *pending.app_id);
+        if (pending.state)
+            put_varint(out, *pending.state);
+        put_outputs(out, pending.outputs_entered);
+        put_outputs(out, pending.outputs_left);
+    }
+
+    // Flushed per batch so that a recording of a session which crashed is still usable
+    m_file.write(out.data(), out.size());
+    m_file.flush();
+}
+
+struct reader {
+    const char *pos;
+    const char *end;
+    bool ok;
+
+    uint8_t byte(void)
+    {
+        if (pos == end) {
+            ok = false;
+            return 0;
+        }
+        return *pos++;
+    }
+
+    uint64_t varint(void)
+    {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (pos == end)
+                break;
+            uint8_t byte = *pos++;
+            value |= (uint64_t)(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                return value;
+        }
+        ok = false;
+        return 0;
+    }
+
+    std::string string(void)
+    {
+        uint64_t len = varint();
+        if (!ok || len > (uint64_t)(end - pos)) {
+            ok = false;
+            return "";
+        }
+        std::string s(pos, len);
+        pos += len;
+        return s;
+    }
+
+    std::vector<struct wl_output *> outputs(void)
+    {
+        uint64_t count = varint();
+        if (!ok || count > (uint64_t)(end - pos)) {
+            ok = false;
+            return {};
+        }
+        std::vector<struct wl_output *> outputs(count);
+        // Any distinct non-null pointer will do; they are only ever compared
+        for (auto &output : outputs)
+            output = reinterpret_cast<struct wl_output *>(varint() + 1);
+        return outputs;
+    }
+};
+
+bool toplevelRecordLoad(const std::string &path, std::vector<struct toplevel_batch> *batches)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+        return false;
+    std::string data(std::istreambuf_iterator<char>(file), {});
+    if (!data.starts_with(MAGIC))
+        return false;
+
+    struct reader in = { data.data() + strlen(MAGIC), data.data() + data.size(), true };
+    std::chrono::microseconds time{ 0 };
+    while (in.ok && in.pos != in.end) {
+        struct toplevel_batch batch;
+        time += std::chrono::microseconds(in.varint());
+        batch.time = time;
+        uint64_t count = in.varint();
+        for (uint64_t i = 0; i < count && in.ok; i++) {
+            struct toplevel_update update = {};
+            update.id = in.varint();
+            uint8_t flags = in.byte();
+            update.added = flags & UPDATE_ADDED;
+            update.closed = flags & UPDATE_CLOSED;
+            if (flags & UPDATE_TITLE)
+                update.pending.title = in.string();
+            if (flags & UPDATE_APP_ID)
+                update.pending.app_id = in.string();
+            if (flags & UPDATE_STATE)
+                update.pending.state = in.varint();
+            update.pending.outputs_entered = in.outputs();
+            update.pending.outputs_left = in.outputs();
+            batch.updates.push_back(std::move(update));
+        }
+        batches->push_back(std::move(batch));
+    }
+
+    // The last batch of a session which ended abruptly may be cut short
+    if (!in.ok) {
+        warn("truncated recording '{}'", path);
+        batches->pop_back();
+    }
+    return !batches->empty();
+}
@@ -0,0 +1,51 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <algorithm>
+#include "toplevel-source.h"
+
+void ToplevelSource::addHandler(void *owner, handler on_updates)
+{
+    m_handlers[owner] = std::move(on_updates);
+
+    std::vector<struct toplevel_update> existing;
+    existing.reserve(m_current.size());
+    for (auto &[id, update] : m_current)
+        existing.push_back(update);
+    if (!existing.empty())
+        m_handlers[owner](existing);
+}
+
+void ToplevelSource::dispatch(const std::vector<struct toplevel_update> &updates)
+{
+    for (auto &update : updates) {
+        if (update.closed) {
+            m_current.erase(update.id);
+            continue;
+        }
+        if (update.added)
+            m_current[update.id] = {
+                .id = update.id, .added = true, .closed = false, .pending = {}
+            };
+        auto it = m_current.find(update.id);
+        if (it == m_current.end())
+            continue;
+
+        // Outputs are kept as entered ones; like the taskbar, apply leaves before enters
+        struct task_pending &current = it->second.pending;
+        const struct task_pending &pending = update.pending;
+        if (pending.title)
+            current.title = pending.title;
+        if (pending.app_id)
+            current.app_id = pending.app_id;
+        if (pending.state)
+            current.state = pending.state;
+        for (auto output : pending.outputs_left)
+            std::erase(current.outputs_entered, output);
+        for (auto output : pending.outputs_entered) {
+            if (std::ranges::find(current.outputs_entered, output) == current.outputs_entered.end())
+                current.outputs_entered.push_back(output);
+        }
+    }
+
+    for (auto &[owner, on_updates] : m_handlers)
+        on_updates(updates);
+}
@@ -0,0 +1,310 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <wayland-client.h>
+#include "log.h"
+#include "conf.h"
+#include "stats.h"
+#include "toplevel-thread.h"
+#include "wlr-foreign-toplevel-management-unstable-v1.h"
+
+const zwlr_foreign_toplevel_handle_v1_listener ToplevelThread::handle_listener = {
+    .title =
+            [](void *data, zwlr_foreign_toplevel_handle_v1 *handle, const char *title) {
+                statsCountWaylandEvent(STATS_LISTENER_TOPLEVEL);
+                static_cast<entry *>(data)->pending.title = title;
+            },
+    .app_id =
+            [](void *data, zwlr_foreign_toplevel_handle_v1 *handle, const char *app_id) {
+                statsCountWaylandEvent(STATS_LISTENER_TOPLEVEL);
+                static_cast<entry *>(data)->pending.app_id = app_id;
+            },
+    /*
+     * The pending lists are applied leaves first, so an enter and a leave of the same output
+     * within one batch cancel out instead of being recorded both.
+     */
+    .output_enter =
+            [](void *data, zwlr_foreign_toplevel_handle_v1 *handle, wl_output *output) {
+                statsCountWaylandEvent(STATS_LISTENER_TOPLEVEL);
+                auto &pending = static_cast<entry *>(data)->pending;
+                if (!std::erase(pending.outputs_left, output))
+                    pending.outputs_entered.push_back(output);
+            },
+    .output_leave =
+            [](void *data, zwlr_foreign_toplevel_handle_v1 *handle, wl_output *output) {
+                statsCountWaylandEvent(STATS_LISTENER_TOPLEVEL);
+                auto &pending = static_cast<entry *>(data)->pending;
+                if (!std::erase(pending.outputs_entered, output))
+                    pending.outputs_left.push_back(output);
+            },
+    .state =
+            [](void *data, zwlr_foreign_toplevel_handle_v1 *handle, wl_array *state) {
+                statsCountWaylandEvent(STATS_LISTENER_TOPLEVEL);
+                uint32_t flags = 0;
+                for (size_t i = 0; i < state->size / sizeof(uint32_t); ++i) {
+                    uint32_t elm = static_cast<uint32_t *>(state->data)[i];
+                    switch (elm) {
+                    case ZWLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_ACTIVATED:
+                        flags |= TASK_ACTIVE;
+                        break;
+                    case ZWLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_MINIMIZED:
+                        flags |= TASK_MINIMIZED;
+                        break;
+                    default:
+                        break;
+                    }
+                }
+                static_cast<entry *>(data)->pending.state = flags;
+            },
+    .done =
+            [](void *data, zwlr_foreign_toplevel_handle_v1 *handle) {
+                statsCountWaylandEvent(STATS_LISTENER_TOPLEVEL);
+                auto toplevel = static_cast<entry *>(data);
+                toplevel->thread->commit(toplevel);
+            },
+    .closed =
+            [](void *data, zwlr_foreign_toplevel_handle_v1 *handle) {
+                statsCountWaylandEvent(STATS_LISTENER_TOPLEVEL);
+                auto toplevel = static_cast<entry *>(data);
+                toplevel->thread->remove(toplevel);
+            },
+    .parent =
+            [](void *data, zwlr_foreign_toplevel_handle_v1 *handle,
+               zwlr_foreign_toplevel_handle_v1 *parent) {
+                statsCountWaylandEvent(STATS_LISTENER_TOPLEVEL);
+            },
+};
+
+ToplevelThread::ToplevelThread(struct wl_display *display, const std::string &record_path)
+    : m_display{ display }, m_manager{ nullptr }, m_recorder{ nullptr }
+{
+    if (!record_path.empty()) {
+        info("record toplevel events to '{}'", record_path);
+        m_recorder = new ToplevelRecorder(record_path);
+    }
+    m_nextId = 1;
+    m_notified = false;
+    m_stop = false;
+    m_wakeup = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (m_wakeup < 0)
+        die("eventfd(): {}", strerror(errno));
+
+    /*
+     * Proxies inherit the queue of the proxy that created them, so binding the registry through
+     * a wrapper puts the manager and every toplevel handle on our queue.
+     */
+    m_queue = wl_display_create_queue(m_display);
+    m_wrapper = static_cast<struct wl_display *>(wl_proxy_create_wrapper(m_display));
+    wl_proxy_set_queue(reinterpret_cast<struct wl_proxy *>(m_wrapper), m_queue);
+    m_registry = wl_display_get_registry(m_wrapper);
+
+    static const wl_registry_listener registry_listener_impl = {
+        .global =
+                [](void *data, wl_registry *registry, uint32_t name, const char *interface,
+                   uint32_t version) {
+                    statsCountWaylandEvent(STATS_LISTENER_REGISTRY);
+                    auto self = static_cast<ToplevelThread *>(data);
+                    if (!strcmp(interface, zwlr_foreign_toplevel_manager_v1_interface.name)) {
+                        self->bindManager(registry, name, version);
+                    }
+                },
+        .global_remove =
+                [](void *data, wl_registry *registry, uint32_t name) {
+                    statsCountWaylandEvent(STATS_LISTENER_REGISTRY);
+                }
+    };
+    wl_registry_add_listener(m_registry, &registry_listener_impl, this);
+
+    m_thread = std::thread([this]() { run(); });
+}
+
+ToplevelThread::~ToplevelThread()
+{
+    m_stop = true;
+    uint64_t one = 1;
+    if (write(m_wakeup, &one, sizeof(one)) < 0)
+        warn("write(): {}", strerror(errno));
+    m_thread.join();
+
+    for (auto &[id, entry] : m_entries) {
+        zwlr_foreign_toplevel_handle_v1_destroy(entry->handle);
+        delete entry;
+    }
+    if (m_manager)
+        zwlr_foreign_toplevel_manager_v1_destroy(m_manager);
+    wl_registry_destroy(m_registry);
+    wl_proxy_wrapper_destroy(m_wrapper);
+    wl_event_queue_destroy(m_queue);
+    close(m_wakeup);
+    delete m_recorder;
+}
+
+void ToplevelThread::bindManager(struct wl_registry *registry, uint32_t name, uint32_t version)
+{
+    version = std::min(version, (uint32_t)zwlr_foreign_toplevel_manager_v1_interface.version);
+    m_manager = static_cast<struct zwlr_foreign_toplevel_manager_v1 *>(
+            wl_registry_bind(registry, name, &zwlr_foreign_toplevel_manager_v1_interface, version));
+    if (!m_manager)
+        die("foreign-toplevel-management protocol not supported by compositor");
+
+    static const zwlr_foreign_toplevel_manager_v1_listener toplevel_manager_impl = {
+        .toplevel =
+                [](void *data, zwlr_foreign_toplevel_manager_v1 *manager,
+                   zwlr_foreign_toplevel_handle_v1 *handle) {
+                    statsCountWaylandEvent(STATS_LISTENER_TOPLEVEL_MANAGER);
+                    static_cast<ToplevelThread *>(data)->addToplevel(handle);
+                },
+        .finished =
+                [](void *data, zwlr_foreign_toplevel_manager_v1 *manager) {
+                    statsCountWaylandEvent(STATS_LISTENER_TOPLEVEL_MANAGER);
+                },
+    };
+    zwlr_foreign_toplevel_manager_v1_add_listener(m_manager, &toplevel_manager_impl, this);
+}
+
+void ToplevelThread::addToplevel(struct zwlr_foreign_toplevel_handle_v1 *handle)
+{
+    auto entry = new struct entry {
+        .thread = this,
+        .id = m_nextId++,
+        .handle = handle,
+        .added = false,
+    };
+    m_entries[entry->id] = entry;
+    zwlr_foreign_toplevel_handle_v1_add_listener(handle, &handle_listener, entry);
+}
+
+/* A toplevel is announced to the GUI thread with its first complete set of properties */
+void ToplevelThread::commit(struct entry *entry)
+{
+    m_batch.push_back({
+            .id = entry->id,
+            .added = !entry->added,
+            .closed = false,
+            .pending = std::exchange(entry->pending, {}),
+    });
+    entry->added = true;
+}
+
+void ToplevelThread::remove(struct entry *entry)
+{
+    if (entry->added)
+        m_batch.push_back({ .id = entry->id, .added = false, .closed = true, .pending = {} });
+    zwlr_foreign_toplevel_handle_v1_destroy(entry->handle);
+    m_entries.erase(entry->id);
+    delete entry;
+}
+
+/* Called on the GUI thread */
+void ToplevelThread::request(uint32_t id, enum toplevel_action action, struct wl_seat *seat)
+{
+    m_requests.push({ .id = id, .action = action, .seat = seat });
+    uint64_t one = 1;
+    if (write(m_wakeup, &one, sizeof(one)) < 0)
+        warn("write(): {}", strerror(errno));
+}
+
+void ToplevelThread::handleRequests(void)
+{
+    while (auto request = m_requests.pop()) {
+        // The toplevel may have been closed since the GUI thread last heard of it
+        auto it = m_entries.find(request->id);
+        if (it == m_entries.end())
+            continue;
+        struct zwlr_foreign_toplevel_handle_v1 *handle = it->second->handle;
+        switch (request->action) {
+        case TOPLEVEL_ACTIVATE:
+            zwlr_foreign_toplevel_handle_v1_activate(handle, request->seat);
+            break;
+        case TOPLEVEL_SET_MINIMIZED:
+            zwlr_foreign_toplevel_handle_v1_set_minimized(handle);
+            break;
+        case TOPLEVEL_UNSET_MINIMIZED:
+            zwlr_foreign_toplevel_handle_v1_unset_minimized(handle);
+            break;
+        }
+    }
+}
+
+/* Hand the updates of one dispatch over, waking the GUI thread unless a wake-up is pending */
+void ToplevelThread::publish(void)
+{
+    if (m_batch.empty())
+        return;
+    if (m_recorder)
+        m_recorder->write(m_batch);
+    m_updates.push(std::exchange(m_batch, {}));
+    if (!m_notified.exchange(true))
+        QMetaObject::invokeMethod(&m_receiver, [this]() { deliver(); }, Qt::QueuedConnection);
+}
+
+void ToplevelThread::deliver(void)
+{
+    m_notified = false;
+    while (auto updates = m_updates.pop())
+        dispatch(*updates);
+}
+
+void ToplevelThread::run(void)
+{
+    pthread_setname_np(pthread_self(), "tint-toplevels");
+
+    if (wl_display_roundtrip_queue(m_display, m_queue) < 0) {
+        warn("wl_display_roundtrip_queue(): {}", strerror(errno));
+        return;
+    }
+
+    struct pollfd fds[] = {
+        { .fd = wl_display_get_fd(m_display), .events = POLLIN, .revents = 0 },
+        { .fd = m_wakeup, .events = POLLIN, .revents = 0 },
+    };
+
+    /*
+     * Qt reads the same socket on its own thread. The prepare/read protocol makes sure that
+     * whichever thread reads, events for our queue end up on it and both threads are woken.
+     */
+    while (!m_stop) {
+        while (wl_display_prepare_read_queue(m_display, m_queue) != 0) {
+            if (wl_display_dispatch_queue_pending(m_display, m_queue) < 0) {
+                warn("wl_display_dispatch_queue_pending(): {}", strerror(errno));
+                return;
+            }
+        }
+        publish();
+        wl_display_flush(m_display);
+
+        if (poll(fds, 2, -1) < 0) {
+            wl_display_cancel_read(m_display);
+            if (errno == EINTR)
+                continue;
+            warn("poll(): {}", strerror(errno));
+            return;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            if (wl_display_read_events(m_display) < 0) {
+                warn("wl_display_read_events(): {}", strerror(errno));
+                return;
+            }
+        } else {
+            wl_display_cancel_read(m_display);
+        }
+
+        if (fds[1].revents & POLLIN) {
+            uint64_t count;
+            if (read(m_wakeup, &count, sizeof(count)) < 0 && errno != EAGAIN)
+                warn("read(): {}", strerror(errno));
+        }
+
+        if (wl_display_dispatch_queue_pending(m_display, m_queue) < 0) {
+            warn("wl_display_dispatch_queue_pending(): {}", strerror(errno));
+            return;
+        }
+        handleRequests();
+    }
+}